@@ -9,21 +9,63 @@
 
 #include "AsiMS2000.h"
 #include "AsiSettings.h"
+#include "JoystickCurve.h"
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
 //needs to be long enough to contain biggest command string.
 #define BUFFERSIZE 128
+
+//Rate of the port to the PC until BAUD changes it, and where BAUD saves it.
+#define DEFAULT_BAUD 9600
+#define EEPROM_BAUD ((uint32_t *)0)
+//How long a new BAUD rate has to get a command before it is given up on.
+#define BAUD_TRIAL_MS 5000
+
+//Rates BAUD takes. 230400 is left out, it is 3.5% off on a 16MHz part.
+static const uint32_t baudRates[] PROGMEM = {9600, 19200, 38400, 57600, 115200, 250000, 500000, 1000000};
 #define DEBUG_SERIAL 0
 
 AsiSettings AsiSettings;
 
 AsiMS2000::AsiMS2000()
 {
-  Serial1.begin(9600);
-  _numCommands = NUMCOMMANDS;
+  _baudRate = DEFAULT_BAUD;
+  _fallbackBaud = DEFAULT_BAUD;
+  _baudTrialStart = 0;
+  _baudTrial = false;
   _isQuery = false;
   _isAxis.x = false;
   _isAxis.y = false;
   _isAxis.z = false;
   _busyStatus = true;
+  _moveCallback = NULL;
+  _scanCallback = NULL;
+  _haltCallback = NULL;
+  _homeCallback = NULL;
+  _joystickCallback = NULL;
+  _homeAxes.x = false;
+  _homeAxes.y = false;
+  _homeAxes.z = false;
+  _haltLine = false;
+  _haltArrived = false;
+  _actualSteps = NULL;
+  _positionVersion = NULL;
+  _lockedOut = NULL;
+  _lockoutFault = NULL;
+  _arrayIndex.x = 0;
+  _arrayIndex.y = 0;
+  _arrayIndex.z = 0;
+  updateStepsPerUnit();
+}
+
+//Open the port to the PC at the rate BAUD last saved, or at 9600 if it never
+//has. Call from setup(), the constructor runs before the Arduino core is
+//set up so it can't start the port.
+void AsiMS2000::begin()
+{
+  uint32_t rate = eeprom_read_dword(EEPROM_BAUD);
+  _baudRate = isBaudRate(rate) ? rate : DEFAULT_BAUD;
+  Serial1.begin(_baudRate);
 }
 
 
@@ -40,52 +82,309 @@ int AsiMS2000::getBusyStatus()
   return _busyStatus;
 }
 
-AxisSettingsF AsiMS2000::getDesiredPos()
+AxisSettings AsiMS2000::getDesiredSteps()
+{
+  return AsiSettings.desiredSteps;
+}
+
+//The motor controller sets where a move it planned itself, like a scan, ends.
+void AsiMS2000::setDesiredSteps(AxisSettings steps)
+{
+  AsiSettings.desiredSteps = steps;
+}
+
+AxisSettingsF AsiMS2000::getMaxSpeed()
+{
+  return AsiSettings.maxSpeed;
+}
+
+AxisSettings AsiMS2000::getAccel()
+{
+  return AsiSettings.accel;
+}
+
+AxisSettingsF AsiMS2000::getStepsPerMm()
+{
+  return AsiSettings.stepsPerMm;
+}
+
+AxisSettings AsiMS2000::getSCurve()
+{
+  return AsiSettings.scurve;
+}
+
+AxisSettings AsiMS2000::getJoystickSpeed()
+{
+  return AsiSettings.jsspd;
+}
+
+AxisSettings AsiMS2000::getJoystickCurve()
+{
+  return AsiSettings.jscurve;
+}
+
+AxisSettingsF AsiMS2000::getBacklash()
+{
+  return AsiSettings.backlash;
+}
+
+AxisSettingsF AsiMS2000::getOvershoot()
+{
+  return AsiSettings.overshoot;
+}
+
+AxisSettings AsiMS2000::getHomeAxes()
+{
+  return _homeAxes;
+}
+
+AxisSettings AsiMS2000::getHomePosition()
+{
+  return AsiSettings.homePosition;
+}
+
+AxisSettingsF AsiMS2000::getScanRange()
+{
+  return AsiSettings.scanr;
+}
+
+AxisSettingsF AsiMS2000::getScanLines()
+{
+  return AsiSettings.scanv;
+}
+
+int AsiMS2000::getScanPattern()
+{
+  return AsiSettings.scanPattern;
+}
+
+//Copy the step counters kept by the motor controller without holding off
+//the interupts. The copy is retried until the position version is the same
+//before and after it, so no count is read half updated.
+AxisSettings AsiMS2000::getCurrentPos()
+{
+  AxisSettings pos = {0, 0, 0};
+  if(_actualSteps == NULL)
+  {
+    return pos;
+  }
+  //the step interupts move the version on with each step. If it has moved
+  //while copying, one of the positions may be half written, so copy again.
+  uint8_t version;
+  do
+  {
+    version = *_positionVersion;
+    pos.x = _actualSteps->x;
+    pos.y = _actualSteps->y;
+    pos.z = _actualSteps->z;
+  } while(version != *_positionVersion);
+  return pos;
+}
+
+//The motor controller owns the position. Positions are kept in steps
+//and only turned into host units when a reply is formatted.
+//The step counts of the motor controller, and a version it moves on each
+//time it writes them, so they can be read without holding off the interupts.
+void AsiMS2000::attachPositionSource(volatile AxisSettings *steps, volatile uint8_t *version)
+{
+  _actualSteps = steps;
+  _positionVersion = version;
+}
+
+//Lockout switches that are closed, and the faults latched when one closed
+//during a move. Both are kept up to date from an interupt.
+void AsiMS2000::attachLockoutSource(volatile AxisSettings *closed, volatile AxisSettings *faults)
+{
+  _lockedOut = closed;
+  _lockoutFault = faults;
+}
+
+//The number of steps in one host unit changes only with UM,
+//so work it out once here instead of on every conversion.
+void AsiMS2000::updateStepsPerUnit()
+{
+  _stepsPerUnit.x = (float)stepConversion * defaultUnitMultiplier / AsiSettings.unitMultiplier.x;
+  _stepsPerUnit.y = (float)stepConversion * defaultUnitMultiplier / AsiSettings.unitMultiplier.y;
+  _stepsPerUnit.z = (float)stepConversion * defaultUnitMultiplier / AsiSettings.unitMultiplier.z;
+  _whereAxes = 0;//the WHERE reply is in the old units.
+}
+
+long AsiMS2000::unitsToSteps(float units, float stepsPerUnit)
+{
+  return lround(units * stepsPerUnit);
+}
+
+float AsiMS2000::stepsToUnits(long steps, float stepsPerUnit)
+{
+  return (float)steps / stepsPerUnit;
+}
+
+//The motor controller registers a function to plan the motion
+//whenever a command changes the desired position.
+void AsiMS2000::attachMoveCallback(void (*callback)())
+{
+  _moveCallback = callback;
+}
+
+//The motor controller registers a function to run the raster scan set up
+//by SCANR and SCANV.
+void AsiMS2000::attachScanCallback(void (*callback)())
+{
+  _scanCallback = callback;
+}
+
+//The motor controller registers a function to find the home switches of
+//the axes getHomeAxes() flags.
+void AsiMS2000::attachHomeCallback(void (*callback)())
+{
+  _homeCallback = callback;
+}
+
+//The motor controller registers a function to work out the joystick speeds
+//again when JSSPD or JSCURVE change them.
+void AsiMS2000::attachJoystickCallback(void (*callback)())
+{
+  _joystickCallback = callback;
+}
+
+//The motor controller registers a function to bring the stage to a stop
+//when a HALT arrives.
+void AsiMS2000::attachHaltCallback(void (*callback)())
 {
-  return AsiSettings.desiredPos;
+  _haltCallback = callback;
 }
 
-AxisSettingsF AsiMS2000::getCurrentPos()
+//Bytes read from the PC that wait for the command before them to finish.
+//Reading them out of the serial port straight away lets a HALT be seen
+//even while the commands ahead of it are held back.
+//The ramp interupt reads the port as well as loop(), so each byte is read
+//and stored with the interupts off.
+#define RX_BACKLOG 64
+static char rxBacklog[RX_BACKLOG];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+static volatile uint8_t rxHaltHead = 0;//the commands before a HALT end here.
+static int bufferPos = 0;
+static int lineOverrun = false;//the line was too long, skip to its end.
+static char commandBuffer [BUFFERSIZE];
+
+//Read whatever has arrived on the serial port into the backlog. A HALT (the
+//\ shortcut) isn't kept, it marks the commands waiting ahead of it to be thrown
+//away by checkHalt(). Safe to call from an interupt, so the sketch can watch
+//for a HALT from its ramp interupt however long a pass of loop() takes.
+//Returns true while a HALT is waiting for checkHalt().
+int AsiMS2000::receiveSerial()
 {
-  return AsiSettings.currentPos;
+  int reading = true;
+  while(reading)
+  {
+    uint8_t oldSREG = SREG;
+    cli();
+    reading = Serial1.available() > 0 && (rxHead + 1) % RX_BACKLOG != rxTail;
+    if(reading)
+    {
+      int inByte = Serial1.read();
+      if(inByte == 92)//backslash
+      {
+        rxHaltHead = rxHead;
+        _haltArrived = true;
+      }
+      else
+      {
+        rxBacklog[rxHead] = inByte;
+        rxHead = (rxHead + 1) % RX_BACKLOG;
+      }
+    }
+    SREG = oldSREG;
+  }
+  return _haltArrived;
 }
 
-void AsiMS2000::setCurrentPos(AxisSettingsF pos)
+//Act on a HALT that has been read. The commands that were waiting ahead of it
+//and the one being typed are thrown away, anything sent after it is kept.
+//Call on every pass of loop(), even while commands have to wait. It also
+//gives up on a BAUD rate nothing has arrived at, which can't be done from
+//the interupt.
+void AsiMS2000::checkHalt()
 {
-  AsiSettings.currentPos = pos;
+  checkBaudTrial();
+  if(!receiveSerial())
+  {
+    return;
+  }
+  noInterrupts();
+  rxTail = rxHaltHead;
+  _haltArrived = false;
+  interrupts();
+  clearCommandBuffer(commandBuffer);
+  bufferPos = 0;
+  lineOverrun = false;
+  _haltLine = true;
+  halt();
 }
 
 //This method should be called from the main sketch in loop();
+//Takes the bytes read so far, and any more that have arrived, until a whole
+//command line is in and has been run, so a command waits one pass of loop()
+//however long it is. Only one command is run each call, the caller checks
+//there is room for its moves before each one. A HALT, read here or by the
+//ramp interupt, ends the call, the commands after it wait until loop() sees
+//the stage stopped.
 void AsiMS2000::checkSerial()
 {
-  int inByte = 0;
-  static int bufferPos = 0;
-  static char commandBuffer [BUFFERSIZE];
-  if(Serial1.available() > 0)
+  while(true)
   {
-    inByte = Serial1.read();
-    if(bufferPos > BUFFERSIZE)
+    if(rxTail == rxHead)
+    {
+      receiveSerial();
+    }
+    //leave the commands ahead of a HALT for checkHalt() to throw away.
+    if(_haltArrived || rxTail == rxHead)
     {
-      bufferPos = 0;
-      bufferOverunError(commandBuffer);
       return;
     }
+    int inByte = rxBacklog[rxTail];
+    rxTail = (rxTail + 1) % RX_BACKLOG;
     
     //check for <CR> or | since arduino env can't send CR.
     if(inByte == 13 || inByte == 124)
     {
+      //the <CR> after a \ ends a command that has already run.
+      if(_haltLine && bufferPos == 0)
+      {
+        _haltLine = false;
+        continue;
+      }
+      _haltLine = false;
+      
+      //the rest of a line that was too long ends here, it has had its error.
+      if(lineOverrun)
+      {
+        lineOverrun = false;
+        continue;
+      }
       commandBuffer[bufferPos]  = '\0';
       inputPrintln(commandBuffer);
       interpretCommand(commandBuffer);
       bufferPos =0;
+      return;
     }
     else if(inByte == 10 || inByte == 27)//backspace or escape
     {
       clearCommandBuffer(commandBuffer);
       bufferPos = 0;
+      lineOverrun = false;
     }
-    else if(inByte > 31)//ignore control characters
+    else if(inByte > 31 && !lineOverrun)//ignore control characters
     {
+      //keep room for the '\0'.
+      if(bufferPos >= BUFFERSIZE - 1)
+      {
+        bufferPos = 0;
+        lineOverrun = true;
+        bufferOverunError(commandBuffer);
+        continue;
+      }
       commandBuffer[bufferPos++] = inByte;
     }
   }
@@ -94,60 +393,37 @@ void AsiMS2000::checkSerial()
 
 void AsiMS2000::interpretCommand(char commandBuffer[])
 {
-    String c = String(commandBuffer);
-    int s = c.indexOf(' ');
-    clearCommandBuffer(commandBuffer);
-    
-    String base;
-    if(s > 0)
-    {
-      base = c.substring(0,s);
-      _args = c.substring(s);
-#if ARDUINO>=100//toUppercase modifies string in place in 1.0
-      _args.toUpperCase();
-#else
-      _args = _args.toUpperCase();
-#endif
-      
-    }
-    else
-    {
-      base = c;
-    }
-    
-    _isQuery = isQueryCommand(c);
-    isAxisInCommand();
-    int commandNum = getCommandNum(base);
+    char *base = tokenizeCommand(commandBuffer);
+    int commandNum = findCommand(base);
     if(commandNum > -1)
     {
+      //a command that makes sense has come in at the new BAUD rate, so the
+      //PC can use it. Keep it for the next power on.
+      if(_baudTrial)
+      {
+        _baudTrial = false;
+        eeprom_update_dword(EEPROM_BAUD, _baudRate);
+      }
       selectCommand(commandNum);
     }
+    clearCommandBuffer(commandBuffer);
 }
 
-void AsiMS2000::isAxisInCommand()
+//Split up the command line and note the axes it names.
+//Returns the command name.
+char* AsiMS2000::tokenizeCommand(char *line)
 {
-    _isAxis.x = false;
-    _isAxis.y = false;
-    _isAxis.z = false;
-    
-    for(int i = 0; i < _args.length(); i++)
-    {
-       if(_args[i] == 'X') {_isAxis.x = true;} 
-       if(_args[i] == 'Y') {_isAxis.y = true;}
-       if(_args[i] == 'Z') {_isAxis.z = true;}
-     }           
+    ::tokenizeCommand(line, &_command);
+    _isQuery = _command.isQuery;
+    _isAxis.x = ::hasArgument(&_command, 'X');
+    _isAxis.y = ::hasArgument(&_command, 'Y');
+    _isAxis.z = ::hasArgument(&_command, 'Z');
+    return _command.base;
 }
 
-int AsiMS2000::isQueryCommand(String command)
+int AsiMS2000::hasArgument(char name)
 {
-  for(int i = 0; i < command.length(); i++)
-  {
-    if(command.charAt(i) == '?')
-    {
-      return true;
-    }
-  }  
-  return false;
+    return ::hasArgument(&_command, name);
 }
 
 void AsiMS2000::settingsQuery(AxisSettings setting)
@@ -222,8 +498,8 @@ void AsiMS2000::settingsSet(AxisSettings *settings)
 {
     AxisSettings units;
     parseXYZArgs(&units);      
-    char buffer [50];
-    sprintf(buffer, "settings x=%d y=%d z=%d", units.x, units.y, units.z);
+    char buffer [64];
+    sprintf(buffer, "settings x=%ld y=%ld z=%ld", units.x, units.y, units.z);
     debugPrintln(buffer);
     if(_isAxis.x) {settings->x = units.x;}
     if(_isAxis.y) {settings->y = units.y;}
@@ -235,8 +511,15 @@ void AsiMS2000::settingsSet(AxisSettingsF *settings)
 {
     AxisSettingsF units;
     parseXYZArgs(&units);      
-    char buffer [50];
-    sprintf(buffer, "settings x=%d y=%d z=%d", units.x, units.y, units.z);
+    //the MEGA's sprintf has no %f, and a float can be 47 characters long.
+    char buffer [160];
+    char number [48];
+    strcpy(buffer, "settings x=");
+    strcat(buffer, dtostrf(units.x,1,6,number));
+    strcat(buffer, " y=");
+    strcat(buffer, dtostrf(units.y,1,6,number));
+    strcat(buffer, " z=");
+    strcat(buffer, dtostrf(units.z,1,6,number));
     debugPrintln(buffer);
     if(_isAxis.x) {settings->x = units.x;}
     if(_isAxis.y) {settings->y = units.y;}
@@ -245,27 +528,78 @@ void AsiMS2000::settingsSet(AxisSettingsF *settings)
 }
 
 
-int AsiMS2000::getCommandNum(String c)
+//A command's place in _spellings. The command number is shifted up to make
+//room for a bit saying whether it is the name or the shortcut. The aliases
+//come after the last command's shortcut, so the commands and aliases
+//together have to fit in a byte.
+#define SPELLING_NAME(commandNum) ((commandNum) << 1)
+#define SPELLING_SHORTCUT(commandNum) ((commandNum) << 1 | 1)
+#define SPELLING_ALIAS(aliasNum) ((NUMCOMMANDS << 1) + (aliasNum))
+
+//Look the command name up in _spellings, which is sorted so a binary search
+//finds any command, W and / included, in 8 compares at most.
+//Replies with an error and returns -1 if there is no such command.
+int AsiMS2000::findCommand(const char *name)
 {
-  for(int i = 0; i < _numCommands; i++)
+  int low = 0;
+  int high = NUMSPELLINGS - 1;
+  while(low <= high)
   {
-    if( c.equalsIgnoreCase(_commands[i]) || c.equalsIgnoreCase(_shortcuts[i]) )
+    int mid = (low + high) / 2;
+    uint8_t spelling = pgm_read_byte(&_spellings[mid]);
+    int commandNum;
+    int compare;
+    if(spelling >= SPELLING_ALIAS(0))
+    {
+      const CommandAlias *alias = &_aliases[spelling - SPELLING_ALIAS(0)];
+      commandNum = pgm_read_byte(&alias->commandNum);
+      compare = strcmp_P(name, alias->name);
+    }
+    else
+    {
+      const CommandInfo *info = &_commands[spelling >> 1];
+      commandNum = spelling >> 1;
+      compare = strcmp_P(name, spelling & 1 ? info->shortcut : info->name);
+    }
+    if(compare == 0)
     {
       if(DEBUG_SERIAL)
       {
-        char buffer [100];
-        sprintf(buffer, "%d: %s, %s", i, _commands[i], _shortcuts[i]);
+        char buffer [50];
+        sprintf(buffer, "%d: %s", commandNum, name);
         debugPrintln(buffer);
       }
-      return i;
-    }     
+      return commandNum;
+    }
+    if(compare < 0) {high = mid - 1;}
+    else {low = mid + 1;}
   }
-  //TODO: one of the commands has a second alias, check for that special case here.
   
   returnErrorToSerial(-1);//unknown command sent if lookup fails.
   return -1;
 }
 
+void AsiMS2000::selectCommand(int commandNum)
+{
+  const CommandInfo *info = &_commands[commandNum];
+  switch(pgm_read_byte(&info->kind))
+  {
+    case COMMAND_NOT_DONE:
+      returnErrorToSerial(-6);
+      break;
+    case COMMAND_METHOD:
+    {
+      CommandHandler handler;
+      memcpy_P(&handler, &info->handler, sizeof(handler));
+      (this->*handler)();
+      break;
+    }
+    default:
+      settingCommand(info);
+      break;
+  }
+}
+
 void AsiMS2000::bufferOverunError(char commandBuffer[])
 {
   returnErrorToSerial(-6);
@@ -283,9 +617,18 @@ void AsiMS2000::clearCommandBuffer(char commandBuffer[])
 void AsiMS2000::displayCommands()
 {
   char buffer [50];
-  for(int i = 0; i < _numCommands; i++)
+  for(int i = 0; i < NUMCOMMANDS; i++)
+  {
+    strcpy_P(buffer, _commands[i].name);
+    strcat(buffer, " => ");
+    strcat_P(buffer, _commands[i].shortcut);
+    debugPrintln(buffer);
+  }
+  for(int i = 0; i < NUMALIASES; i++)
   {
-    sprintf(buffer, "%s => %s", _commands[i], _shortcuts[i]);
+    strcpy_P(buffer, _aliases[i].name);
+    strcat(buffer, " => ");
+    strcat_P(buffer, _commands[pgm_read_byte(&_aliases[i].commandNum)].name);
     debugPrintln(buffer);
   }
 }
@@ -304,26 +647,11 @@ void AsiMS2000::parseXYZArgs(AxisSettingsF *units)
   units->z = atof(GetArgumentValue('Z'));
 }
 
-char* AsiMS2000::GetArgumentValue(char arg)
+//The value of the argument called arg, as text in the command line,
+//or "0" if it wasn't given.
+const char* AsiMS2000::GetArgumentValue(char arg)
 {
-  int argIndex = _args.indexOf(arg);
-  if(argIndex == -1)
-  {
-   return "0";
-  }
-
-  char buffer[20];
-  int bIndex = 0;
-  while(_args.charAt(argIndex) != ' ' && argIndex < _args.length())
-  {
-   argIndex++;
-   if(_args.charAt(argIndex) != '=')
-   {
-     buffer[bIndex++] = _args.charAt(argIndex);
-   }   
-  }
-  buffer[bIndex] = '\0';
-  return buffer;
+  return argumentValue(&_command, arg);
 }
 
 
@@ -335,7 +663,7 @@ void AsiMS2000::serialPrint(String data)
    serialPrint(buffer);
 }
 
-void AsiMS2000::serialPrint(char* data)
+void AsiMS2000::serialPrint(const char* data)
 {
   outputPrintln(data);
   Serial1.print(data);
@@ -348,7 +676,7 @@ void AsiMS2000::serialPrintln(String data)
    serialPrintln(buffer);
 }
 
-void AsiMS2000::serialPrintln(char* data)
+void AsiMS2000::serialPrintln(const char* data)
 {
   outputPrintln(data);
   Serial1.println(data);
@@ -361,21 +689,21 @@ void AsiMS2000::debugPrintln(String data)
   debugPrintln(buffer);
 }
 
-void AsiMS2000::debugPrintln(char* data)
+void AsiMS2000::debugPrintln(const char* data)
 {
   Serial.print("DEBUG:[");
   Serial.print(data);
   Serial.println("]");
 }
 
-void AsiMS2000::outputPrintln(char * data)
+void AsiMS2000::outputPrintln(const char * data)
 {
   if(! DEBUG_SERIAL) {return;}
   Serial.print("Out>");
   Serial.println(data);
 }
 
-void AsiMS2000::inputPrintln(char * data)
+void AsiMS2000::inputPrintln(const char * data)
 {
   if(! DEBUG_SERIAL) {return;}
   Serial.print("IN<");
@@ -442,14 +770,38 @@ void AsiMS2000::getSetCommand2(AxisSettingsF *setting)
     }
 }
 
+//Get or set the setting of a command that does nothing else, replying the
+//way the command's table entry says.
+void AsiMS2000::settingCommand(const CommandInfo *info)
+{
+    void *setting = pgm_read_ptr(&info->setting);
+    int colon = pgm_read_byte(&info->reply) == REPLY_COLON;
+    if(pgm_read_byte(&info->kind) == COMMAND_LONG_AXES)
+    {
+      if(colon) {getSetCommand2((AxisSettings *)setting);}
+      else {getSetCommand((AxisSettings *)setting);}
+    }
+    else
+    {
+      if(colon) {getSetCommand2((AxisSettingsF *)setting);}
+      else {getSetCommand((AxisSettingsF *)setting);}
+    }
+}
 
 //call to display detailed position information on the debug port.
-void AsiMS2000::displayCurrentToDesired(char message[])
+void AsiMS2000::displayCurrentToDesired(const char message[])
 {
     char buffer[20];
     String reply = String(message);    
-    AxisSettingsF a = AsiSettings.currentPos;
-    AxisSettingsF d = AsiSettings.desiredPos;
+    AxisSettings steps = getCurrentPos();
+    AxisSettingsF a;
+    AxisSettingsF d;
+    a.x = stepsToUnits(steps.x, _stepsPerUnit.x);
+    a.y = stepsToUnits(steps.y, _stepsPerUnit.y);
+    a.z = stepsToUnits(steps.z, _stepsPerUnit.z);
+    d.x = stepsToUnits(AsiSettings.desiredSteps.x, _stepsPerUnit.x);
+    d.y = stepsToUnits(AsiSettings.desiredSteps.y, _stepsPerUnit.y);
+    d.z = stepsToUnits(AsiSettings.desiredSteps.z, _stepsPerUnit.z);
     dtostrf(a.x,1,4,buffer);
     reply.concat(" " + String(buffer) + "->");
     dtostrf(d.x,1,4,buffer);
@@ -468,539 +820,394 @@ void AsiMS2000::displayCurrentToDesired(char message[])
     debugPrintln(reply);
 }
 
-/* These are the commands from the protocols. The program looks up the command
- * and runs the desired method from below. The methods 
- * 
- *
+/* These are the commands from the protocols. The program looks the command up
+ * in _commands, at the end of the file, and runs the method it names from
+ * below. Commands that only get or set a setting, and those not done yet,
+ * need no method.
  */
-void AsiMS2000::accel()
+//AHOME X=? Y=? sets the first tile of the ARRAY, in host units.
+//With no position the current position is used.
+void AsiMS2000::ahome()
 {
-    returnErrorToSerial(-6);
+    AxisSettings home = AsiSettings.arrayHome;
+    if(_isQuery)
+    {
+      AxisSettingsF units;
+      units.x = stepsToUnits(home.x, _stepsPerUnit.x);
+      units.y = stepsToUnits(home.y, _stepsPerUnit.y);
+      units.z = 0;
+      settingsQuery(units);
+      return;
+    }
+    
+    if(!_isAxis.x && !_isAxis.y)
+    {
+      AxisSettings steps = getCurrentPos();
+      home.x = steps.x;
+      home.y = steps.y;
+    }
+    else
+    {
+      AxisSettingsF units;
+      parseXYZArgs(&units);
+      if(_isAxis.x) {home.x = unitsToSteps(units.x, _stepsPerUnit.x);}
+      if(_isAxis.y) {home.y = unitsToSteps(units.y, _stepsPerUnit.y);}
+    }
+    AsiSettings.arrayHome = home;
+    serialPrintln(":A");
 }
 
 
-void AsiMS2000::aalign()
+//AIJ X=column Y=row moves to a tile of the ARRAY, counting from 1.
+//With no tile it reports the tile the array is on.
+void AsiMS2000::aij()
 {
-    returnErrorToSerial(-6);
+    if(_isQuery || (!_isAxis.x && !_isAxis.y))
+    {
+      _isAxis.x = true;
+      _isAxis.y = true;
+      _isAxis.z = false;
+      settingsQuery(_arrayIndex);
+      return;
+    }
+    
+    AxisSettings tile;
+    parseXYZArgs(&tile);
+    if(!_isAxis.x) {tile.x = max(_arrayIndex.x, 1);}
+    if(!_isAxis.y) {tile.y = max(_arrayIndex.y, 1);}
+    if(tile.x < 1 || tile.x > AsiSettings.arrayCount.x ||
+       tile.y < 1 || tile.y > AsiSettings.arrayCount.y)
+    {
+      returnErrorToSerial(-4);
+      return;
+    }
+    _arrayIndex.x = tile.x;
+    _arrayIndex.y = tile.y;
+    serialPrintln(":A");
+    arrayMove();
 }
 
-void AsiMS2000::afcont()
-{
-    returnErrorToSerial(-6);
-
 
+//ARRAY X=columns Y=rows Z=column spacing F=row spacing (mm) sets up a grid
+//of tiles from AHOME. ARRAY on its own, or a TTL pulse with TTL X=1, moves to
+//the next tile along the rows and back to the first after the last, so a
+//mosaic needs no MOVE for each tile.
+void AsiMS2000::array()
+{
+    if(_isQuery)
+    {
+      char buffer[60];
+      char spacingX[15];
+      char spacingY[15];
+      dtostrf(AsiSettings.arraySpacing.x,1,6,spacingX);
+      dtostrf(AsiSettings.arraySpacing.y,1,6,spacingY);
+      sprintf(buffer, ":A X=%ld Y=%ld Z=%s F=%s", AsiSettings.arrayCount.x, AsiSettings.arrayCount.y, spacingX, spacingY);
+      serialPrintln(buffer);
+      return;
+    }
+    
+    int hasSpacingY = hasArgument('F');
+    if(_isAxis.x || _isAxis.y || _isAxis.z || hasSpacingY)
+    {
+      AxisSettingsF values;
+      parseXYZArgs(&values);
+      if(_isAxis.x) {AsiSettings.arrayCount.x = (long)values.x;}
+      if(_isAxis.y) {AsiSettings.arrayCount.y = (long)values.y;}
+      if(_isAxis.z) {AsiSettings.arraySpacing.x = values.z;}
+      if(hasSpacingY) {AsiSettings.arraySpacing.y = atof(GetArgumentValue('F'));}
+      _arrayIndex.x = 0;
+      _arrayIndex.y = 0;
+      serialPrintln(":A");
+      return;
+    }
+    
+    if(AsiSettings.arrayCount.x < 1 || AsiSettings.arrayCount.y < 1)
+    {
+      returnErrorToSerial(-5);
+      return;
+    }
+    serialPrintln(":A");
+    arrayNext();
 }
 
-
-void AsiMS2000::aflim()
+//Step the ARRAY on to the next tile.
+void AsiMS2000::arrayNext()
 {
-    returnErrorToSerial(-6);
-
-
+    if(AsiSettings.arrayCount.x < 1 || AsiSettings.arrayCount.y < 1)
+    {
+      return;
+    }
+    if(_arrayIndex.x < 1 || _arrayIndex.y < 1)
+    {
+      _arrayIndex.x = 1;
+      _arrayIndex.y = 1;
+    }
+    else if(++_arrayIndex.x > AsiSettings.arrayCount.x)
+    {
+      _arrayIndex.x = 1;
+      if(++_arrayIndex.y > AsiSettings.arrayCount.y)
+      {
+        _arrayIndex.y = 1;
+      }
+    }
+    arrayMove();
 }
 
-
-void AsiMS2000::afocus()
+//Move to the tile in _arrayIndex.
+void AsiMS2000::arrayMove()
 {
-    returnErrorToSerial(-6);
-
-
+    _busyStatus = true;
+    AsiSettings.desiredSteps.x = AsiSettings.arrayHome.x + lround((_arrayIndex.x - 1) * AsiSettings.arraySpacing.x * AsiSettings.stepsPerMm.x);
+    AsiSettings.desiredSteps.y = AsiSettings.arrayHome.y + lround((_arrayIndex.y - 1) * AsiSettings.arraySpacing.y * AsiSettings.stepsPerMm.y);
+    displayCurrentToDesired("Array");
+    if(_moveCallback != NULL)
+    {
+      _moveCallback();
+    }
 }
 
-
-void AsiMS2000::afset()
+//Called by the motor controller for each pulse on the TTL input.
+void AsiMS2000::ttlPulse()
 {
-    returnErrorToSerial(-6);
-
-
+    if(AsiSettings.ttl.x == TTL_IN_ARRAY)
+    {
+      arrayNext();
+    }
 }
 
 
-void AsiMS2000::afmove()
+void AsiMS2000::build()
 {
-    returnErrorToSerial(-6);
-
-
+  if(hasArgument('X'))
+  {
+    serialPrintln("STD_XYZ");    
+  }
+  else
+  {
+    serialPrintln("Build: 0.0.0.1");    
+  }
 }
 
 
-void AsiMS2000::ahome()
+void AsiMS2000::cdate()
 {
-    returnErrorToSerial(-6);
-
-
+  serialPrintln("2012-02-25 15:30:00");//update for revisions. Does Arduino have a macro for this?
 }
 
 
-void AsiMS2000::aij()
+//Stop every axis with a controlled deceleration, drop the queued moves and
+//end any scan. Busy clears once the stage has stopped.
+void AsiMS2000::halt()
 {
-    returnErrorToSerial(-6);
-
-
+    if(_haltCallback != NULL)
+    {
+      _haltCallback();
+    }
+    serialPrintln(":A");
 }
 
 
-void AsiMS2000::array()
+//HERE X=? Y=? Z=? says the stage is at the given position, in host units,
+//without moving it. An axis given without a position is set to 0.
+void AsiMS2000::here()
 {
-    returnErrorToSerial(-6);
-
-
+    AxisSettingsF units;
+    AxisSettings steps;
+    parseXYZArgs(&units);
+    steps.x = unitsToSteps(units.x, _stepsPerUnit.x);
+    steps.y = unitsToSteps(units.y, _stepsPerUnit.y);
+    steps.z = unitsToSteps(units.z, _stepsPerUnit.z);
+    definePosition(steps, _isAxis);
 }
 
 
-void AsiMS2000::azero()
+//HOME X Y Z finds the home switches of the axes given, all three if none are.
+//Each axis runs fast onto its switch, backs off and comes back slowly to
+//find it, then backs off again to stop clear of it at the SETHOME position.
+//An axis that doesn't find its switch within the stage travel stops all of
+//them, with a fault on RDSTAT.
+void AsiMS2000::home()
 {
-    returnErrorToSerial(-6);
-
-
+    if(!_isAxis.x && !_isAxis.y && !_isAxis.z)
+    {
+      _isAxis.x = true;
+      _isAxis.y = true;
+      _isAxis.z = true;
+    }
+    _homeAxes = _isAxis;
+    
+    //moves sent while homing run from the home position.
+    if(_isAxis.x) {AsiSettings.desiredSteps.x = AsiSettings.homePosition.x;}
+    if(_isAxis.y) {AsiSettings.desiredSteps.y = AsiSettings.homePosition.y;}
+    if(_isAxis.z) {AsiSettings.desiredSteps.z = AsiSettings.homePosition.z;}
+    _busyStatus = true;
+    serialPrintln(":A");
+    if(_homeCallback != NULL)
+    {
+      _homeCallback();
+    }
 }
 
 
-void AsiMS2000::backlash()
+//X= is the fast joystick speed, at full deflection, and Y= the slow speed, at
+//half deflection, both as a percentage of the top joystick speed.
+void AsiMS2000::jsspd()
 {
-  getSetCommand2(&AsiSettings.backlash);  
-}
-
-
-void AsiMS2000::bcustom()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::benable()
-{
-  returnErrorToSerial(-6);
-}
-
-
-void AsiMS2000::build()
-{
-  if(_args.indexOf('X') > -1)
-  {
-    serialPrintln("STD_XYZ");    
-  }
-  else
-  {
-    serialPrintln("Build: 0.0.0.1");    
-  }
-}
-
-
-void AsiMS2000::cdate()
-{
-  serialPrintln("2012-02-25 15:30:00");//update for revisions. Does Arduino have a macro for this?
-}
-
-
-void AsiMS2000::cnts()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::customa()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::customb()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::dack()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::dump()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::ensync()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::epolarity()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::error()
-{
-      getSetCommand2(&AsiSettings.error);
-}
-
-
-void AsiMS2000::halt()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::here()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::home()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::info()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::joystick()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::jsspd()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::kadc()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::kd()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::ki()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::kp()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::lcd()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::led()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::lladdr()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::load()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::lock()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::lockrg()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::lockset()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::maintain()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::motctrl()
-{
-    returnErrorToSerial(-6);
-
-
+    getSetCommand(&AsiSettings.jsspd);
+    AsiSettings.jsspd.x = constrain(AsiSettings.jsspd.x, 0, 100);
+    AsiSettings.jsspd.y = constrain(AsiSettings.jsspd.y, 0, AsiSettings.jsspd.x);
+    if(!_isQuery && _joystickCallback != NULL)
+    {
+      _joystickCallback();
+    }
 }
 
 
+//Targets are turned into steps once, here. Axes left out of the command stay put.
 void AsiMS2000::move()
 {
-  //TODO:consider unitMultiplier
   _busyStatus = true;
   AxisSettingsF units;  
   parseXYZArgs(&units);
-  AsiSettings.desiredPos.x = units.x;
-  AsiSettings.desiredPos.y = units.y;
-  AsiSettings.desiredPos.z = units.z;
+  if(_isAxis.x) {AsiSettings.desiredSteps.x = unitsToSteps(units.x, _stepsPerUnit.x);}
+  if(_isAxis.y) {AsiSettings.desiredSteps.y = unitsToSteps(units.y, _stepsPerUnit.y);}
+  if(_isAxis.z) {AsiSettings.desiredSteps.z = unitsToSteps(units.z, _stepsPerUnit.z);}
   serialPrintln(":A");
   displayCurrentToDesired("Move");  
+  if(_moveCallback != NULL)
+  {
+    _moveCallback();
+  }
 }
 
 
+//Relative moves add whole steps to the target so repeated moves don't drift.
 void AsiMS2000::movrel()
 {
-  //TODO: consider unitMultiplier
   _busyStatus = true;
   AxisSettingsF units;  
   parseXYZArgs(&units);
-  AsiSettings.desiredPos.x += units.x;
-  AsiSettings.desiredPos.y += units.y;
-  AsiSettings.desiredPos.z += units.z;
+  AsiSettings.desiredSteps.x += unitsToSteps(units.x, _stepsPerUnit.x);
+  AsiSettings.desiredSteps.y += unitsToSteps(units.y, _stepsPerUnit.y);
+  AsiSettings.desiredSteps.z += unitsToSteps(units.z, _stepsPerUnit.z);
   serialPrintln(":A");  
   displayCurrentToDesired("MoveRel");
+  if(_moveCallback != NULL)
+  {
+    _moveCallback();
+  }
 }
 
 
-void AsiMS2000::pcros()
-{
-      getSetCommand(&AsiSettings.pcros);
-}
-
-
-void AsiMS2000::pedal()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::rbmode()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::rdadc()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::rdsbyte()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
+//Reply with a status byte for each axis asked for, or all of them, in decimal.
+//A latched fault adds STATUS_FAULT on top of the byte. Reading a fault clears
+//it, once the switch has opened again.
 void AsiMS2000::rdstat()
 {
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::relock()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::reset()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::rt()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::runaway()
-{
-    returnErrorToSerial(-6);
-
-
+    if(_command.argumentCount == 0)
+    {
+      _isAxis.x = true;
+      _isAxis.y = true;
+      _isAxis.z = true;
+    }
+    
+    AxisSettings closed = {0, 0, 0};
+    AxisSettings faults = {0, 0, 0};
+    if(_lockedOut != NULL)
+    {
+      noInterrupts();
+      closed.x = _lockedOut->x;
+      closed.y = _lockedOut->y;
+      closed.z = _lockedOut->z;
+      faults.x = _lockoutFault->x;
+      faults.y = _lockoutFault->y;
+      faults.z = _lockoutFault->z;
+      if(_isAxis.x && !closed.x){_lockoutFault->x = false;}
+      if(_isAxis.y && !closed.y){_lockoutFault->y = false;}
+      if(_isAxis.z && !closed.z){_lockoutFault->z = false;}
+      interrupts();
+    }
+    
+    String response = ":A ";
+    if(_isAxis.x){response.concat(String(statusByte(closed.x, faults.x)) + " ");}
+    if(_isAxis.y){response.concat(String(statusByte(closed.y, faults.y)) + " ");}
+    if(_isAxis.z){response.concat(String(statusByte(closed.z, faults.z)) + " ");}
+    serialPrintln(response);
 }
 
-
-void AsiMS2000::saveset()
+int AsiMS2000::statusByte(long closed, long fault)
 {
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::savepos()
-{
-    returnErrorToSerial(-6);
-
-
+    int status = 0;
+    if(_busyStatus){status |= STATUS_MOVING;}
+    if(closed){status |= STATUS_LOCKOUT;}
+    if(fault){status |= STATUS_FAULT;}
+    return status;
 }
 
 
+//SCAN on its own runs the raster scan set up by SCANR and SCANV, with a
+//pulse on the TTL output at the start of the scan and of every line.
+//SCAN F= sets the pattern, see the SCAN_ patterns.
 void AsiMS2000::scan()
 {
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::scanr()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::scanv()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::secure()
-{
-    returnErrorToSerial(-6);
-
-
+    if(hasArgument('F'))
+    {
+      if(_isQuery)
+      {
+        char buffer[20];
+        sprintf(buffer, ":A F=%ld", AsiSettings.scanPattern);
+        serialPrintln(buffer);
+        return;
+      }
+      AsiSettings.scanPattern = atol(GetArgumentValue('F'));
+      serialPrintln(":A");
+      return;
+    }
+    
+    if(AsiSettings.scanr.x == AsiSettings.scanr.y || AsiSettings.scanv.z < 1)
+    {
+      returnErrorToSerial(-4);
+      return;
+    }
+    _busyStatus = true;
+    serialPrintln(":A");
+    if(_scanCallback != NULL)
+    {
+      _scanCallback();
+    }
 }
 
 
+//SETHOME X=? Y=? Z=? sets the position HOME finishes at, just clear of the
+//home switches, in host units.
+//With no position the current position is used for all three axes.
 void AsiMS2000::sethome()
 {
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::setlow()
-{
-    getSetCommand(&AsiSettings.setlow);
-}
-
-
-void AsiMS2000::setup()
-{
-    getSetCommand(&AsiSettings.setup);
-}
-
-
-void AsiMS2000::si()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::speed()
-{
-  getSetCommand(&AsiSettings.maxSpeed); 
-}
-
-
-
-void AsiMS2000::spin()
-{
-    returnErrorToSerial(-6);
+    AxisSettings home = AsiSettings.homePosition;
+    if(_isQuery)
+    {
+      AxisSettingsF units;
+      units.x = stepsToUnits(home.x, _stepsPerUnit.x);
+      units.y = stepsToUnits(home.y, _stepsPerUnit.y);
+      units.z = stepsToUnits(home.z, _stepsPerUnit.z);
+      settingsQuery(units);
+      return;
+    }
+    
+    if(!_isAxis.x && !_isAxis.y && !_isAxis.z)
+    {
+      home = getCurrentPos();
+    }
+    else
+    {
+      AxisSettingsF units;
+      parseXYZArgs(&units);
+      if(_isAxis.x) {home.x = unitsToSteps(units.x, _stepsPerUnit.x);}
+      if(_isAxis.y) {home.y = unitsToSteps(units.y, _stepsPerUnit.y);}
+      if(_isAxis.z) {home.z = unitsToSteps(units.z, _stepsPerUnit.z);}
+    }
+    AsiSettings.homePosition = home;
+    serialPrintln(":A");
 }
 
 
@@ -1018,56 +1225,10 @@ void AsiMS2000::status()
 }
 
 
-void AsiMS2000::stopbits()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::ttl()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
 void AsiMS2000::um()
 {
     getSetCommand(&AsiSettings.unitMultiplier);
-}
-
-
-void AsiMS2000::units()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::unlock()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::vb()
-{
-    returnErrorToSerial(-6);
-
-
-}
-
-
-void AsiMS2000::vector()
-{
-    returnErrorToSerial(-6);
-
-
+    updateStepsPerUnit();
 }
 
 
@@ -1077,373 +1238,427 @@ void AsiMS2000::version()
 }
 
 
-void AsiMS2000::wait()
-{
-  getSetCommand2(&AsiSettings.wait);    
-}
-
-
+//The host polls WHERE far more often than the stage moves, so the reply is
+//kept and only worked out again when the position or the axes asked for change.
 void AsiMS2000::where()
 {
-    int arglen = _args.length();
-    char buffer [25];
-    if(arglen == 0)
+    if(_command.argumentCount == 0)
     {
       _isAxis.x = true;
       _isAxis.y = true;
       _isAxis.z = true;
     }
     
-    String response = ":A ";
-    //char buffer [25];
-    if(_isAxis.x) 
-    {
-      
-      dtostrf(AsiSettings.currentPos.x,1,1,buffer);
-      response.concat(String(buffer) + " ");
-    }
-  
-    if(_isAxis.y) 
+    AxisSettings steps = getCurrentPos();
+    uint8_t axes = (_isAxis.x ? 1 : 0) | (_isAxis.y ? 2 : 0) | (_isAxis.z ? 4 : 0);
+    if(axes != _whereAxes || steps.x != _whereSteps.x ||
+       steps.y != _whereSteps.y || steps.z != _whereSteps.z)
     {
-      dtostrf(AsiSettings.currentPos.y,1,1,buffer);
-      response.concat(String(buffer) + " ");
+      //positions are kept in steps, convert to host units only for the reply.
+      char *end = _whereReply;
+      strcpy(end, ":A ");
+      end += 3;
+      if(_isAxis.x) {end = appendUnits(end, stepsToUnits(steps.x, _stepsPerUnit.x));}
+      if(_isAxis.y) {end = appendUnits(end, stepsToUnits(steps.y, _stepsPerUnit.y));}
+      if(_isAxis.z) {end = appendUnits(end, stepsToUnits(steps.z, _stepsPerUnit.z));}
+      _whereSteps = steps;
+      _whereAxes = axes;
     }
     
-    if(_isAxis.z) 
-    {
-      dtostrf(AsiSettings.currentPos.z,1,1,buffer);
-      response.concat(String(buffer) + " ");
-    }
-  
-    serialPrintln(response);
+    serialPrintln(_whereReply);
 }
 
-
-void AsiMS2000::who()
+//Write units to one decimal place and a space at end, and return the new end.
+char* AsiMS2000::appendUnits(char *end, float units)
 {
-    returnErrorToSerial(-6);
-
-
+    dtostrf(units, 1, 1, end);
+    end += strlen(end);
+    *end++ = ' ';
+    *end = '\0';
+    return end;
 }
 
 
-void AsiMS2000::wrdac()
+//ZERO makes the current position the origin of all three axes.
+void AsiMS2000::zero()
 {
-    returnErrorToSerial(-6);
-
-
+    AxisSettings steps = {0, 0, 0};
+    AxisSettings axes = {true, true, true};
+    definePosition(steps, axes);
 }
 
 
-void AsiMS2000::zero()
+//Set the position of the axes flagged in axes without moving them.
+//The queued moves are planned from the old origin, so not while busy.
+void AsiMS2000::definePosition(AxisSettings steps, AxisSettings axes)
 {
-    returnErrorToSerial(-6);
-
-
+    if(_busyStatus || _actualSteps == NULL)
+    {
+      returnErrorToSerial(-5);
+      return;
+    }
+    noInterrupts();
+    if(axes.x) {_actualSteps->x = steps.x;}
+    if(axes.y) {_actualSteps->y = steps.y;}
+    if(axes.z) {_actualSteps->z = steps.z;}
+    (*_positionVersion)++;
+    interrupts();
+    if(axes.x) {AsiSettings.desiredSteps.x = steps.x;}
+    if(axes.y) {AsiSettings.desiredSteps.y = steps.y;}
+    if(axes.z) {AsiSettings.desiredSteps.z = steps.z;}
+    serialPrintln(":A");
 }
 
 
-void AsiMS2000::z2b()
+//X= picks the shape of the slow half of the joystick travel, see
+//JoystickCurve.h. With the user curve Y= and Z= are the percentage of the
+//slow speed at a third and two thirds of the way.
+void AsiMS2000::jscurve()
 {
-    returnErrorToSerial(-6);
-
-
+    getSetCommand(&AsiSettings.jscurve);
+    AsiSettings.jscurve.x = constrain(AsiSettings.jscurve.x, JOYSTICK_CURVE_LINEAR, JOYSTICK_CURVE_USER);
+    AsiSettings.jscurve.y = constrain(AsiSettings.jscurve.y, 0, 100);
+    AsiSettings.jscurve.z = constrain(AsiSettings.jscurve.z, AsiSettings.jscurve.y, 100);
+    if(!_isQuery && _joystickCallback != NULL)
+    {
+      _joystickCallback();
+    }
 }
 
-void AsiMS2000::overshoot()
+//Not part of the ASI protocol. BAUD X=rate changes the rate of the port to
+//the PC, once the :A has gone at the old rate. The new rate is saved for the
+//next power on when the first command arrives at it. If none does within
+//BAUD_TRIAL_MS the port goes back to the old rate, so a rate the PC can't
+//use doesn't cut it off.
+void AsiMS2000::baud()
 {
-  getSetCommand(&AsiSettings.overshoot);   
+    if(_isQuery)
+    {
+      AxisSettings rate = {(long)_baudRate, 0, 0};
+      settingsQuery(rate);
+      return;
+    }
+    
+    unsigned long rate = strtoul(GetArgumentValue('X'), NULL, 10);
+    if(!_isAxis.x || !isBaudRate(rate))
+    {
+      returnErrorToSerial(-4);
+      return;
+    }
+    serialPrintln(":A");
+    if(rate == _baudRate)
+    {
+      return;
+    }
+    Serial1.flush();//let the :A go first.
+    _fallbackBaud = _baudRate;
+    _baudRate = rate;
+    _baudTrialStart = millis();
+    _baudTrial = true;
+    noInterrupts();
+    Serial1.begin(_baudRate);
+    interrupts();
 }
 
-
-void AsiMS2000::zs()
+int AsiMS2000::isBaudRate(unsigned long rate)
 {
-  getSetCommand(&AsiSettings.zs);
+  for(uint8_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
+  {
+    if(pgm_read_dword(&baudRates[i]) == rate)
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
-void AsiMS2000::selectCommand(int commandNum)
+//Go back to the old rate if nothing has come in at a new BAUD rate in time.
+//Whatever did arrive was at the wrong rate, so it is thrown away.
+void AsiMS2000::checkBaudTrial()
 {
-  switch(commandNum)
+  if(!_baudTrial || millis() - _baudTrialStart < BAUD_TRIAL_MS)
   {
-      case 0:
-          accel();
-          break;
-      case 1:
-          aalign();
-          break;
-      case 2:
-          afcont();
-          break;
-      case 3:
-          aflim();
-          break;
-      case 4:
-          afocus();
-          break;
-      case 5:
-          afset();
-          break;
-      case 6:
-          afmove();
-          break;
-      case 7:
-          ahome();
-          break;
-      case 8:
-          aij();
-          break;
-      case 9:
-          array();
-          break;
-      case 10:
-          azero();
-          break;
-      case 11:
-          backlash();
-          break;
-      case 12:
-          bcustom();
-          break;
-      case 13:
-          benable();
-          break;
-      case 14:
-          build();
-          break;
-      case 15:
-          cdate();
-          break;
-      case 16:
-          cnts();
-          break;
-      case 17:
-          customa();
-          break;
-      case 18:
-          customb();
-          break;
-      case 19:
-          dack();
-          break;
-      case 20:
-          dump();
-          break;
-      case 21:
-          ensync();
-          break;
-      case 22:
-          epolarity();
-          break;
-      case 23:
-          error();
-          break;
-      case 24:
-          halt();
-          break;
-      case 25:
-          here();
-          break;
-      case 26:
-          home();
-          break;
-      case 27:
-          info();
-          break;
-      case 28:
-          joystick();
-          break;
-      case 29:
-          jsspd();
-          break;
-      case 30:
-          kadc();
-          break;
-      case 31:
-          kd();
-          break;
-      case 32:
-          ki();
-          break;
-      case 33:
-          kp();
-          break;
-      case 34:
-          lcd();
-          break;
-      case 35:
-          led();
-          break;
-      case 36:
-          lladdr();
-          break;
-      case 37:
-          load();
-          break;
-      case 38:
-          lock();
-          break;
-      case 39:
-          lockrg();
-          break;
-      case 40:
-          lockset();
-          break;
-      case 41:
-          maintain();
-          break;
-      case 42:
-          motctrl();
-          break;
-      case 43:
-          move();
-          break;
-      case 44:
-          movrel();
-          break;
-      case 45:
-          pcros();
-          break;
-      case 46:
-          pedal();
-          break;
-      case 47:
-          rbmode();
-          break;
-      case 48:
-          rdadc();
-          break;
-      case 49:
-          rdsbyte();
-          break;
-      case 50:
-          rdstat();
-          break;
-      case 51:
-          relock();
-          break;
-      case 52:
-          reset();
-          break;
-      case 53:
-          rt();
-          break;
-      case 54:
-          runaway();
-          break;
-      case 55:
-          saveset();
-          break;
-      case 56:
-          savepos();
-          break;
-      case 57:
-          scan();
-          break;
-      case 58:
-          scanr();
-          break;
-      case 59:
-          scanv();
-          break;
-      case 60:
-          secure();
-          break;
-      case 61:
-          sethome();
-          break;
-      case 62:
-          setlow();
-          break;
-      case 63:
-          setup();
-          break;
-      case 64:
-          si();
-          break;
-      case 65:
-          speed();
-          break;
-      case 66:
-          spin();
-          break;
-      case 67:
-          status();
-          break;
-      case 68:
-          stopbits();
-          break;
-      case 69:
-          ttl();
-          break;
-      case 70:
-          um();
-          break;
-      case 71:
-          units();
-          break;
-      case 72:
-          unlock();
-          break;
-      case 73:
-          vb();
-          break;
-      case 74:
-          vector();
-          break;
-      case 75:
-          version();
-          break;
-      case 76:
-          wait();
-          break;
-      case 77:
-          where();
-          break;
-      case 78:
-          who();
-          break;
-      case 79:
-          wrdac();
-          break;
-      case 80:
-          zero();
-          break;
-      case 81:
-          z2b();
-          break;
-      case 82:
-          zs();
-          break;
-      case 83:
-          overshoot();
-          break;
+    return;
   }
-}
-
-
-char*  AsiMS2000::_commands[] =
-        {"ACCEL","AALIGN","AFCONT","AFLIM","AFOCUS","AFSET","AFMOVE",
-                  "AHOME","AIJ","ARRAY","AZERO","BACKLASH","BCUSTOM","BENABLE","BUILD",
-                  "CDATE","CNTS","CUSTOMA","CUSTOMB","DACK","DUMP","ENSYNC","EPOLARITY",
-                  "ERROR","HALT","HERE","HOME","INFO","JOYSTICK","JSSPD","KADC","KD","KI",
-                  "KP","LCD","LED","LLADDR","LOAD","LOCK","LOCKRG","LOCKSET","MAINTAIN",
-                  "MOTCTRL","MOVE","MOVREL","PCROS","PEDAL","RBMODE","RDADC","RDSBYTE",
-                  "RDSTAT","RELOCK","RESET","RT","RUNAWAY","SAVESET","SAVEPOS","SCAN",
-                  "SCANR","SCANV","SECURE","SETHOME","SETLOW","SETUP","SI","SPEED","SPIN",
-                  "STATUS","STOPBITS","TTL","UM","UNITS","UNLOCK","VB","VECTOR","VERSION",
-                  "WAIT","WHERE","WHO","WRDAC","ZERO","Z2B","ZS","OVERSHOOT"
-                  };
-                  
-char* AsiMS2000::_shortcuts[] =
-        {"AC","AA","AFCONT","AFLIM","AFOCUS","AFSET","AFMOVE",
-                   "AH","IJ","AR","AZ","B","BCA","BE","BU",
-                   "CD","C","CCA","CCB","D","DU","ES","EP",
-                   "E","\\","H","!","I","J","JS","KA","KD","KI",
-                   "KP","LCD","LED","LL","LD","LK","LR","LS","MA",
-                   "MC","M","R","PC","PD","RM","RA","RB",
-                   "RS","RL","~","RT","RU","SS","SP","SN",
-                   "NR","NV","SECURE","HM","SL","SU","SI","S","@",
-                   "/","SB","TTL","UM","UN","UL","VB","VE","V",
-                   "WT","W","N","WRDAC","Z","Z2B","ZS","OS"
-                   };
-
+  _baudTrial = false;
+  _baudRate = _fallbackBaud;
+  //the ramp interupt reads the port too, so switch it with the interupts off.
+  noInterrupts();
+  Serial1.begin(_baudRate);
+  rxTail = rxHead;
+  _haltArrived = false;
+  interrupts();
+  clearCommandBuffer(commandBuffer);
+  bufferPos = 0;
+  lineOverrun = false;
+}
+
+//The commands of the protocol. _spellings finds them by their place here,
+//so new commands go at the end.
+const CommandInfo AsiMS2000::_commands[NUMCOMMANDS] PROGMEM =
+{
+  {"ACCEL", "AC", COMMAND_LONG_AXES, REPLY_A, &AsiSettings.accel, NULL},
+  {"AALIGN", "AA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AFCONT", "AFCONT", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AFLIM", "AFLIM", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AFOCUS", "AFOCUS", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AFSET", "AFSET", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AFMOVE", "AFMOVE", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"AHOME", "AH", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::ahome},
+  {"AIJ", "IJ", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::aij},
+  {"ARRAY", "AR", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::array},
+  {"AZERO", "AZ", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"BACKLASH", "B", COMMAND_FLOAT_AXES, REPLY_COLON, &AsiSettings.backlash, NULL},
+  {"BCUSTOM", "BCA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"BENABLE", "BE", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"BUILD", "BU", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::build},
+  {"CDATE", "CD", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::cdate},
+  //CNTS X=? is the number of steps in a mm of travel. SPEED is turned into a
+  //step rate with it, so set it to suit the screws of the stage.
+  {"CNTS", "C", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.stepsPerMm, NULL},
+  {"CUSTOMA", "CCA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"CUSTOMB", "CCB", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"DACK", "D", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"DUMP", "DU", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"ENSYNC", "ES", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"EPOLARITY", "EP", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"ERROR", "E", COMMAND_FLOAT_AXES, REPLY_COLON, &AsiSettings.error, NULL},
+  {"HALT", "\\", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::halt},
+  {"HERE", "H", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::here},
+  {"HOME", "!", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::home},
+  {"INFO", "I", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"JOYSTICK", "J", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"JSSPD", "JS", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::jsspd},
+  {"KADC", "KA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"KD", "KD", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"KI", "KI", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"KP", "KP", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LCD", "LCD", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LED", "LED", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LLADDR", "LL", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LOAD", "LD", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LOCK", "LK", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LOCKRG", "LR", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"LOCKSET", "LS", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"MAINTAIN", "MA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"MOTCTRL", "MC", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"MOVE", "M", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::move},
+  {"MOVREL", "R", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::movrel},
+  {"PCROS", "PC", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.pcros, NULL},
+  {"PEDAL", "PD", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RBMODE", "RM", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RDADC", "RA", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RDSBYTE", "RB", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RDSTAT", "RS", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::rdstat},
+  {"RELOCK", "RL", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RESET", "~", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RT", "RT", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"RUNAWAY", "RU", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"SAVESET", "SS", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"SAVEPOS", "SP", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"SCAN", "SN", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::scan},
+  //SCANR X=start Y=stop (mm) of the fast axis, X.
+  //The fast axis crosses the range at its SPEED.
+  {"SCANR", "NR", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.scanr, NULL},
+  //SCANV X=start Y=stop (mm) Z=lines of the slow axis, Y.
+  {"SCANV", "NV", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.scanv, NULL},
+  {"SECURE", "SECURE", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"SETHOME", "HM", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::sethome},
+  {"SETLOW", "SL", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.setlow, NULL},
+  {"SETUP", "SU", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.setup, NULL},
+  {"SI", "SI", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"SPEED", "S", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.maxSpeed, NULL},
+  {"SPIN", "@", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"STATUS", "/", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::status},
+  {"STOPBITS", "SB", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  //TTL X=input mode. See the TTL_IN modes.
+  {"TTL", "TTL", COMMAND_LONG_AXES, REPLY_A, &AsiSettings.ttl, NULL},
+  {"UM", "UM", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::um},
+  {"UNITS", "UN", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"UNLOCK", "UL", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"VB", "VB", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"VECTOR", "VE", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"VERSION", "V", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::version},
+  {"WAIT", "WT", COMMAND_LONG_AXES, REPLY_COLON, &AsiSettings.wait, NULL},
+  {"WHERE", "W", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::where},
+  {"WHO", "N", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"WRDAC", "WRDAC", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"ZERO", "Z", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::zero},
+  {"Z2B", "Z2B", COMMAND_NOT_DONE, REPLY_A, NULL, NULL},
+  {"ZS", "ZS", COMMAND_LONG_AXES, REPLY_A, &AsiSettings.zs, NULL},
+  {"OVERSHOOT", "OS", COMMAND_FLOAT_AXES, REPLY_A, &AsiSettings.overshoot, NULL},
+  //Not part of the ASI protocol. SCURVE X=1 makes moves on X use a jerk limited
+  //S-curve ramp instead of a trapezoid. Both take the ACCEL time to reach SPEED.
+  {"SCURVE", "SC", COMMAND_LONG_AXES, REPLY_A, &AsiSettings.scurve, NULL},
+  {"JSCURVE", "JC", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::jscurve},
+  {"BAUD", "BD", COMMAND_METHOD, REPLY_A, NULL, &AsiMS2000::baud}
+};
+
+//Other names the commands go by. SETUP sets the upper limit and is also
+//SETUPPER, to go with SETLOW.
+const CommandAlias AsiMS2000::_aliases[NUMALIASES] PROGMEM =
+{
+  {"SETUPPER", 63}
+};
+
+//Every name, shortcut and alias, sorted for findCommand. Any spelling added
+//to _commands or _aliases needs a line here, in its place in strcmp order.
+const uint8_t AsiMS2000::_spellings[NUMSPELLINGS] PROGMEM =
+{
+  SPELLING_SHORTCUT(26),//"!"
+  SPELLING_SHORTCUT(67),//"/"
+  SPELLING_SHORTCUT(66),//"@"
+  SPELLING_SHORTCUT(1),//"AA"
+  SPELLING_NAME(1),//"AALIGN"
+  SPELLING_SHORTCUT(0),//"AC"
+  SPELLING_NAME(0),//"ACCEL"
+  SPELLING_NAME(2),//"AFCONT"
+  SPELLING_NAME(3),//"AFLIM"
+  SPELLING_NAME(6),//"AFMOVE"
+  SPELLING_NAME(4),//"AFOCUS"
+  SPELLING_NAME(5),//"AFSET"
+  SPELLING_SHORTCUT(7),//"AH"
+  SPELLING_NAME(7),//"AHOME"
+  SPELLING_NAME(8),//"AIJ"
+  SPELLING_SHORTCUT(9),//"AR"
+  SPELLING_NAME(9),//"ARRAY"
+  SPELLING_SHORTCUT(10),//"AZ"
+  SPELLING_NAME(10),//"AZERO"
+  SPELLING_SHORTCUT(11),//"B"
+  SPELLING_NAME(11),//"BACKLASH"
+  SPELLING_NAME(86),//"BAUD"
+  SPELLING_SHORTCUT(12),//"BCA"
+  SPELLING_NAME(12),//"BCUSTOM"
+  SPELLING_SHORTCUT(86),//"BD"
+  SPELLING_SHORTCUT(13),//"BE"
+  SPELLING_NAME(13),//"BENABLE"
+  SPELLING_SHORTCUT(14),//"BU"
+  SPELLING_NAME(14),//"BUILD"
+  SPELLING_SHORTCUT(16),//"C"
+  SPELLING_SHORTCUT(17),//"CCA"
+  SPELLING_SHORTCUT(18),//"CCB"
+  SPELLING_SHORTCUT(15),//"CD"
+  SPELLING_NAME(15),//"CDATE"
+  SPELLING_NAME(16),//"CNTS"
+  SPELLING_NAME(17),//"CUSTOMA"
+  SPELLING_NAME(18),//"CUSTOMB"
+  SPELLING_SHORTCUT(19),//"D"
+  SPELLING_NAME(19),//"DACK"
+  SPELLING_SHORTCUT(20),//"DU"
+  SPELLING_NAME(20),//"DUMP"
+  SPELLING_SHORTCUT(23),//"E"
+  SPELLING_NAME(21),//"ENSYNC"
+  SPELLING_SHORTCUT(22),//"EP"
+  SPELLING_NAME(22),//"EPOLARITY"
+  SPELLING_NAME(23),//"ERROR"
+  SPELLING_SHORTCUT(21),//"ES"
+  SPELLING_SHORTCUT(25),//"H"
+  SPELLING_NAME(24),//"HALT"
+  SPELLING_NAME(25),//"HERE"
+  SPELLING_SHORTCUT(61),//"HM"
+  SPELLING_NAME(26),//"HOME"
+  SPELLING_SHORTCUT(27),//"I"
+  SPELLING_SHORTCUT(8),//"IJ"
+  SPELLING_NAME(27),//"INFO"
+  SPELLING_SHORTCUT(28),//"J"
+  SPELLING_SHORTCUT(85),//"JC"
+  SPELLING_NAME(28),//"JOYSTICK"
+  SPELLING_SHORTCUT(29),//"JS"
+  SPELLING_NAME(85),//"JSCURVE"
+  SPELLING_NAME(29),//"JSSPD"
+  SPELLING_SHORTCUT(30),//"KA"
+  SPELLING_NAME(30),//"KADC"
+  SPELLING_NAME(31),//"KD"
+  SPELLING_NAME(32),//"KI"
+  SPELLING_NAME(33),//"KP"
+  SPELLING_NAME(34),//"LCD"
+  SPELLING_SHORTCUT(37),//"LD"
+  SPELLING_NAME(35),//"LED"
+  SPELLING_SHORTCUT(38),//"LK"
+  SPELLING_SHORTCUT(36),//"LL"
+  SPELLING_NAME(36),//"LLADDR"
+  SPELLING_NAME(37),//"LOAD"
+  SPELLING_NAME(38),//"LOCK"
+  SPELLING_NAME(39),//"LOCKRG"
+  SPELLING_NAME(40),//"LOCKSET"
+  SPELLING_SHORTCUT(39),//"LR"
+  SPELLING_SHORTCUT(40),//"LS"
+  SPELLING_SHORTCUT(43),//"M"
+  SPELLING_SHORTCUT(41),//"MA"
+  SPELLING_NAME(41),//"MAINTAIN"
+  SPELLING_SHORTCUT(42),//"MC"
+  SPELLING_NAME(42),//"MOTCTRL"
+  SPELLING_NAME(43),//"MOVE"
+  SPELLING_NAME(44),//"MOVREL"
+  SPELLING_SHORTCUT(78),//"N"
+  SPELLING_SHORTCUT(58),//"NR"
+  SPELLING_SHORTCUT(59),//"NV"
+  SPELLING_SHORTCUT(83),//"OS"
+  SPELLING_NAME(83),//"OVERSHOOT"
+  SPELLING_SHORTCUT(45),//"PC"
+  SPELLING_NAME(45),//"PCROS"
+  SPELLING_SHORTCUT(46),//"PD"
+  SPELLING_NAME(46),//"PEDAL"
+  SPELLING_SHORTCUT(44),//"R"
+  SPELLING_SHORTCUT(48),//"RA"
+  SPELLING_SHORTCUT(49),//"RB"
+  SPELLING_NAME(47),//"RBMODE"
+  SPELLING_NAME(48),//"RDADC"
+  SPELLING_NAME(49),//"RDSBYTE"
+  SPELLING_NAME(50),//"RDSTAT"
+  SPELLING_NAME(51),//"RELOCK"
+  SPELLING_NAME(52),//"RESET"
+  SPELLING_SHORTCUT(51),//"RL"
+  SPELLING_SHORTCUT(47),//"RM"
+  SPELLING_SHORTCUT(50),//"RS"
+  SPELLING_NAME(53),//"RT"
+  SPELLING_SHORTCUT(54),//"RU"
+  SPELLING_NAME(54),//"RUNAWAY"
+  SPELLING_SHORTCUT(65),//"S"
+  SPELLING_NAME(56),//"SAVEPOS"
+  SPELLING_NAME(55),//"SAVESET"
+  SPELLING_SHORTCUT(68),//"SB"
+  SPELLING_SHORTCUT(84),//"SC"
+  SPELLING_NAME(57),//"SCAN"
+  SPELLING_NAME(58),//"SCANR"
+  SPELLING_NAME(59),//"SCANV"
+  SPELLING_NAME(84),//"SCURVE"
+  SPELLING_NAME(60),//"SECURE"
+  SPELLING_NAME(61),//"SETHOME"
+  SPELLING_NAME(62),//"SETLOW"
+  SPELLING_NAME(63),//"SETUP"
+  SPELLING_ALIAS(0),//"SETUPPER"
+  SPELLING_NAME(64),//"SI"
+  SPELLING_SHORTCUT(62),//"SL"
+  SPELLING_SHORTCUT(57),//"SN"
+  SPELLING_SHORTCUT(56),//"SP"
+  SPELLING_NAME(65),//"SPEED"
+  SPELLING_NAME(66),//"SPIN"
+  SPELLING_SHORTCUT(55),//"SS"
+  SPELLING_NAME(67),//"STATUS"
+  SPELLING_NAME(68),//"STOPBITS"
+  SPELLING_SHORTCUT(63),//"SU"
+  SPELLING_NAME(69),//"TTL"
+  SPELLING_SHORTCUT(72),//"UL"
+  SPELLING_NAME(70),//"UM"
+  SPELLING_SHORTCUT(71),//"UN"
+  SPELLING_NAME(71),//"UNITS"
+  SPELLING_NAME(72),//"UNLOCK"
+  SPELLING_SHORTCUT(75),//"V"
+  SPELLING_NAME(73),//"VB"
+  SPELLING_SHORTCUT(74),//"VE"
+  SPELLING_NAME(74),//"VECTOR"
+  SPELLING_NAME(75),//"VERSION"
+  SPELLING_SHORTCUT(77),//"W"
+  SPELLING_NAME(76),//"WAIT"
+  SPELLING_NAME(77),//"WHERE"
+  SPELLING_NAME(78),//"WHO"
+  SPELLING_NAME(79),//"WRDAC"
+  SPELLING_SHORTCUT(76),//"WT"
+  SPELLING_SHORTCUT(80),//"Z"
+  SPELLING_NAME(81),//"Z2B"
+  SPELLING_NAME(80),//"ZERO"
+  SPELLING_NAME(82),//"ZS"
+  SPELLING_SHORTCUT(24),//"\"
+  SPELLING_SHORTCUT(52),//"~"
+};
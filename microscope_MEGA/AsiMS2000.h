@@ -17,50 +17,147 @@
 #endif
 
 #include "AsiSettings.h"
+#include "CommandLine.h"
 
-#define NUMCOMMANDS 84
+#define NUMCOMMANDS 87
+//Other names a command goes by, besides its name and shortcut.
+#define NUMALIASES 1
+//Names, shortcuts and aliases of all the commands. Some shortcuts are the
+//name again and are counted once.
+#define NUMSPELLINGS 156
 #define BUFFERLEN 128
+
+class AsiMS2000;
+typedef void (AsiMS2000::*CommandHandler)();
+
+//What a command does, see CommandInfo.
+#define COMMAND_NOT_DONE 0//replies :E-6.
+#define COMMAND_METHOD 1//runs handler.
+#define COMMAND_LONG_AXES 2//gets or sets the AxisSettings at setting.
+#define COMMAND_FLOAT_AXES 3//gets or sets the AxisSettingsF at setting.
+
+//How a setting query reply starts.
+#define REPLY_A 0//":A X=1 "
+#define REPLY_COLON 1//":X=1 "
+
+//One command of the protocol. The table of these is kept in flash, so a
+//command that only gets and sets a setting needs no code of its own.
+struct CommandInfo {
+  char name[10];
+  char shortcut[7];
+  uint8_t kind;
+  uint8_t reply;
+  void *setting;
+  CommandHandler handler;
+};
+
+//Another name for the command at commandNum in the command table.
+struct CommandAlias {
+  char name[10];
+  uint8_t commandNum;
+};
+
+//TTL X= input modes.
+#define TTL_IN_OFF 0
+#define TTL_IN_ARRAY 1//each pulse moves to the next ARRAY tile.
+
+//SCAN F= patterns.
+#define SCAN_RASTER 0//every line is scanned the same way.
+#define SCAN_SERPENTINE 1//every other line is scanned back.
+
+//RDSTAT status byte bits, as the MS2000 defines them. The lockouts sit at
+//the negative end of each axis, so they are its lower limit switches.
+#define STATUS_MOVING 0x01//a command move is still running.
+#define STATUS_LOCKOUT 0x80//the lower limit (lockout) switch is closed.
+//Every bit of the byte has a meaning already, so the fault goes above it.
+#define STATUS_FAULT 0x100//the lockout closed during a move. Cleared by reading.
+
 class AsiMS2000
 {    
   public:
         AsiMS2000();
+        void begin();
         void checkSerial();
+        int receiveSerial();
+        void checkHalt();
         void displayCommands();
         void clearBusyStatus();
         int  getBusyStatus();
-        AxisSettingsF getCurrentPos();
-        AxisSettingsF getDesiredPos();
-        void setCurrentPos(AxisSettingsF pos);
-        void displayCurrentToDesired(char message[]);
+        AxisSettings getCurrentPos();
+        AxisSettings getDesiredSteps();
+        void setDesiredSteps(AxisSettings steps);
+        AxisSettingsF getMaxSpeed();
+        AxisSettings getAccel();
+        AxisSettingsF getStepsPerMm();
+        AxisSettings getSCurve();
+        AxisSettingsF getBacklash();
+        AxisSettingsF getOvershoot();
+        AxisSettings getHomeAxes();
+        AxisSettings getHomePosition();
+        AxisSettings getJoystickSpeed();
+        AxisSettings getJoystickCurve();
+        AxisSettingsF getScanRange();
+        AxisSettingsF getScanLines();
+        int getScanPattern();
+        void attachPositionSource(volatile AxisSettings *steps, volatile uint8_t *version);
+        void attachLockoutSource(volatile AxisSettings *closed, volatile AxisSettings *faults);
+        void attachMoveCallback(void (*callback)());
+        void attachScanCallback(void (*callback)());
+        void attachHaltCallback(void (*callback)());
+        void attachHomeCallback(void (*callback)());
+        void attachJoystickCallback(void (*callback)());
+        void displayCurrentToDesired(const char message[]);
+        void ttlPulse();
         
   private:
         volatile int _busyStatus;
-        int _numCommands;
+        void (*_moveCallback)();
+        void (*_scanCallback)();
+        void (*_haltCallback)();
+        void (*_homeCallback)();
+        void (*_joystickCallback)();
+        AxisSettings _homeAxes;//axes the last HOME was for.
+        int _haltLine;//a \ has been acted on and its <CR> is still to come.
+        volatile int _haltArrived;//a \ has been read and not yet acted on.
+        unsigned long _baudRate;
+        unsigned long _fallbackBaud;//rate to go back to if nothing arrives at _baudRate.
+        unsigned long _baudTrialStart;
+        int _baudTrial;//_baudRate is still to be shown to work.
+        volatile AxisSettings *_actualSteps;
+        volatile uint8_t *_positionVersion;
+        AxisSettings _whereSteps;//position the WHERE reply is for.
+        uint8_t _whereAxes;//axes in the WHERE reply, 0 if there isn't one.
+        char _whereReply[48];
+        volatile AxisSettings *_lockedOut;
+        volatile AxisSettings *_lockoutFault;
+        AxisSettingsF _stepsPerUnit;
+        AxisSettings _arrayIndex;//tile the array is on, from 1. 0 before the first.
         int _isQuery;
         AxisSettings _isAxis;
-        static char* _commands[NUMCOMMANDS];
-        static char* _shortcuts[NUMCOMMANDS];
-        String _args;       
-        void serialPrint(char*);
+        static const CommandInfo _commands[NUMCOMMANDS];
+        static const CommandAlias _aliases[NUMALIASES];
+        static const uint8_t _spellings[NUMSPELLINGS];
+        CommandLine _command;//the command being run, split up.
+        void serialPrint(const char*);
         void serialPrint(String data);
-        void serialPrintln(char *);
+        void serialPrintln(const char *);
         void serialPrintln(String data);
         void interpretCommand(char commandBuffer[]);
         void bufferOverunError(char commandBuffer[]);
         void clearCommandBuffer(char commandBuffer[]);
         void returnErrorToSerial(int errornum);
-        int getCommandNum(String c);
+        int findCommand(const char *name);
         void selectCommand(int commandNum);
-        void debugPrintln(char* data);
+        void debugPrintln(const char* data);
         void debugPrintln(String data);
-        void outputPrintln(char* data);
+        void outputPrintln(const char* data);
         void inputPrint(byte data);
-        void inputPrintln(char * data);
+        void inputPrintln(const char * data);
         void parseXYZArgs(AxisSettings *);
         void parseXYZArgs(AxisSettingsF *);
-        char* GetArgumentValue(char arg);
-        int isQueryCommand(String command);
-        void isAxisInCommand();
+        char* tokenizeCommand(char *line);
+        int hasArgument(char name);
+        const char* GetArgumentValue(char arg);
         void settingsQuery(AxisSettings settings);
         void settingsQuery(AxisSettings settings, String reply);
         void settingsQuery(AxisSettingsF settings);
@@ -71,93 +168,41 @@ class AsiMS2000
         void getSetCommand(AxisSettingsF *settings);
         void getSetCommand2(AxisSettings *setting);
         void getSetCommand2(AxisSettingsF *setting);
+        void settingCommand(const CommandInfo *info);
+        void updateStepsPerUnit();
+        long unitsToSteps(float units, float stepsPerUnit);
+        float stepsToUnits(long steps, float stepsPerUnit);
+        void arrayNext();
+        void arrayMove();
+        void definePosition(AxisSettings steps, AxisSettings axes);
+        int statusByte(long closed, long fault);
+        char* appendUnits(char *end, float units);
+        int isBaudRate(unsigned long rate);
+        void checkBaudTrial();
 /////////////////////
 //Protocol commands//
 /////////////////////
-	void accel();
-	void aalign();
-	void afcont();
-	void aflim();
-	void afocus();
-	void afset();
-	void afmove();
 	void ahome();
 	void aij();
 	void array();
-	void azero();
-	void backlash();
-	void bcustom();
-	void benable();
 	void build();
 	void cdate();
-	void cnts();
-	void customa();
-	void customb();
-	void dack();
-	void dump();
-	void ensync();
-	void epolarity();
-	void error();
 	void halt();
 	void here();
 	void home();
-	void info();
-	void joystick();
 	void jsspd();
-	void kadc();
-	void kd();
-	void ki();
-	void kp();
-	void lcd();
-	void led();
-	void lladdr();
-	void load();
-	void lock();
-	void lockrg();
-	void lockset();
-	void maintain();
-	void motctrl();
 	void move();
 	void movrel();
-	void pcros();
-	void pedal();
-	void rbmode();
-	void rdadc();
-	void rdsbyte();
 	void rdstat();
-	void relock();
-	void reset();
-	void rt();
-	void runaway();
-	void saveset();
-	void savepos();
 	void scan();
-	void scanr();
-	void scanv();
-	void secure();
 	void sethome();
-	void setlow();
-	void setup();
-	void si();
-	void speed();
-	void spin();
 	void status();
-	void stopbits();
-	void ttl();
 	void um();
-	void units();
-	void unlock();
-	void vb();
-	void vector();
 	void version();
-	void wait();
 	void where();
-	void who();
-	void wrdac();
 	void zero();
-	void z2b();
-	void zs();
-        void overshoot();
+	void jscurve();
+	void baud();
 };
 
 
@@ -13,19 +13,32 @@ AsiSettings::AsiSettings()
 {
   //set power on defaults.
   //TODO: Store config information in the EEPROM if needed.
-  setSettings(&currentPos, 1.1, 2.02, 3.003);
-  setSettings(&desiredPos, 1.1, 2.02, 3.003); 
+  setSettings(&desiredSteps, 1100, 2020, 3003);
   setSettings(&maxSpeed, 7.1, 7.2, 7.3); 
-  setSettings(&unitMultiplier, 1000, 1000, 1000);
+  setSettings(&unitMultiplier, defaultUnitMultiplier, defaultUnitMultiplier, defaultUnitMultiplier);
   setSettings(&wait, 0,0,0);
   setSettings(&backlash, 0,0,0);
   setSettings(&error, 0,0,0);
   setSettings(&pcros, 0,0,0); 
   setSettings(&accel, 50,50,50);
+  setSettings(&scurve, 0,0,0);
   setSettings(&setlow, 0,0,0);
   setSettings(&setup, 100,100,100); 
   setSettings(&zs, 0,0,0); 
   setSettings(&overshoot, 0,0,0);
+  //200 step motors in 1/8th steps, one turn a mm until CNTS is set for the
+  //screws of the stage.
+  setSettings(&stepsPerMm, 1600,1600,1600);
+  setSettings(&ttl, 0,0,0);
+  setSettings(&arrayCount, 0,0,0);
+  setSettings(&arraySpacing, 0,0,0);
+  setSettings(&arrayHome, 0,0,0);
+  setSettings(&homePosition, 0,0,0);
+  setSettings(&jsspd, 100,25,0);
+  setSettings(&jscurve, 1,11,44);
+  setSettings(&scanr, 0,0,0);
+  setSettings(&scanv, 0,0,1);
+  scanPattern = 0;
 }
 
 void AsiSettings::setSettings(AxisSettings *s, int x, int y, int z)
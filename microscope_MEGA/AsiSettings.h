@@ -15,6 +15,15 @@
 #include <Wprogram.h> // Arduino 0022
 #endif
 
+//The actual position is kept as whole steps. Steps divided by this factor
+//give the position in host units at the default unit multiplier.
+const int stepConversion = 1000;
+const long defaultUnitMultiplier = 1000;
+
+//mm the longest axis of the stage can travel. HOME gives up on a switch it
+//hasn't found in that far.
+const float stageTravel = 100.0;
+
 struct AxisSettings {
   long x;
   long y;
@@ -32,8 +41,7 @@ class AsiSettings
 {
   public:
     AsiSettings(); 
-    AxisSettingsF currentPos;
-    AxisSettingsF desiredPos;
+    AxisSettings desiredSteps;
     AxisSettingsF maxSpeed;
     AxisSettingsF backlash;
     AxisSettingsF error;
@@ -41,10 +49,22 @@ class AsiSettings
     AxisSettingsF setlow;
     AxisSettingsF setup;
     AxisSettingsF overshoot;
+    AxisSettingsF stepsPerMm;//steps in a mm of travel, from CNTS.
     AxisSettings accel;
+    AxisSettings scurve;
     AxisSettings unitMultiplier;
     AxisSettings wait;
     AxisSettings zs;
+    AxisSettings ttl;//X is the TTL input mode.
+    AxisSettings arrayCount;//tiles along X and Y.
+    AxisSettingsF arraySpacing;//mm between tiles along X and Y.
+    AxisSettings arrayHome;//first tile, in steps.
+    AxisSettings homePosition;//position of the home switches, in steps.
+    AxisSettings jsspd;//joystick speed at full (X) and half (Y) deflection, in percent.
+    AxisSettings jscurve;//joystick curve (X), and the user curve (Y, Z) in percent.
+    AxisSettingsF scanr;//fast axis (X) scan from X= to Y=, in mm.
+    AxisSettingsF scanv;//slow axis (Y) lines from X= to Y=, Z= lines.
+    long scanPattern;//SCAN_RASTER or SCAN_SERPENTINE.
   private:
     void setSettings(AxisSettings *s, int x, int y, int z);
     void setSettings(AxisSettingsF *s, float x, float y, float z);		
@@ -0,0 +1,72 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "CommandLine.h"
+
+//Split the command line where it lies, in one pass. Each part is upper cased
+//and ended with a '\0'. The first is the command name, the ones after it are
+//noted in the argument list, along with whether any part asks a query.
+void tokenizeCommand(char *line, CommandLine *command)
+{
+  command->argumentCount = 0;
+  command->isQuery = false;
+  
+  while(*line == ' ') {line++;}
+  command->base = line;
+  char *c = line;
+  while(*c != '\0')
+  {
+    if(*c == ' ')
+    {
+      *c++ = '\0';
+      continue;
+    }
+    int isArgument = c != command->base;
+    char *start = c;
+    for(; *c != '\0' && *c != ' '; c++)
+    {
+      *c = toupper(*c);
+      if(*c == '?') {command->isQuery = true;}
+    }
+    if(!isArgument || command->argumentCount == MAX_ARGUMENTS)
+    {
+      continue;
+    }
+    
+    //the value follows the name, after an = if there is one.
+    CommandArgument *argument = &command->arguments[command->argumentCount++];
+    argument->name = *start++;
+    if(*start == '=') {start++;}
+    argument->value = start;
+  }
+}
+
+int hasArgument(CommandLine *command, char name)
+{
+  for(uint8_t i = 0; i < command->argumentCount; i++)
+  {
+    if(command->arguments[i].name == name)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//The value of the argument called name, as text in the command line,
+//or "0" if it wasn't given.
+const char *argumentValue(CommandLine *command, char name)
+{
+  for(uint8_t i = 0; i < command->argumentCount; i++)
+  {
+    if(command->arguments[i].name == name)
+    {
+      return command->arguments[i].value;
+    }
+  }
+  return "0";
+}
@@ -0,0 +1,39 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef CommandLine_h
+#define CommandLine_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+
+//Most arguments a command can have. Any more are ignored.
+#define MAX_ARGUMENTS 8
+
+//One argument of a command, such as X=1.5, X? or X. value points into the
+//command line and is "" when there is none.
+struct CommandArgument {
+  char name;
+  const char *value;
+};
+
+//A command line split up where it lies, without copying any of it.
+struct CommandLine {
+  char *base;//the command name.
+  CommandArgument arguments[MAX_ARGUMENTS];
+  uint8_t argumentCount;
+  int isQuery;//some part of the line has a ?.
+};
+
+void tokenizeCommand(char *line, CommandLine *command);
+int hasArgument(CommandLine *command, char name);
+const char *argumentValue(CommandLine *command, char name);
+
+#endif
@@ -0,0 +1,88 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "JoystickAdc.h"
+
+#define JOYSTICK_CHANNELS 3
+
+//Two sets of readings. The interupt fills one while the foreground reads the
+//other, and swaps them over when it has read every channel.
+static volatile int samples[2][JOYSTICK_CHANNELS];
+static volatile uint8_t readBuffer = 0;//the set the foreground reads.
+static volatile unsigned long rounds = 0;//sets filled since the start.
+
+static uint8_t channels[JOYSTICK_CHANNELS];
+static volatile uint8_t resultChannel = 0;//index of the conversion that finishes next.
+static volatile uint8_t muxChannel = 0;//index the multiplexer is set to.
+
+static void selectChannel(uint8_t index)
+{
+  ADMUX = _BV(REFS0) | (channels[index] & 0x07);//AVcc reference.
+}
+
+//Start reading the three joystick pins, A0 to A7, for good.
+void startJoystickAdc(int xPin, int yPin, int zPin)
+{
+  channels[0] = xPin - A0;
+  channels[1] = yPin - A0;
+  channels[2] = zPin - A0;
+  
+  uint8_t oldSREG = SREG;
+  cli();
+  resultChannel = 0;
+  muxChannel = 0;
+  selectChannel(0);
+  ADCSRB = 0;//free running, channels below 8.
+  DIDR0 |= _BV(channels[0]) | _BV(channels[1]) | _BV(channels[2]);//no digital input buffers on the pots.
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | JOYSTICK_ADC_PRESCALE;
+  SREG = oldSREG;
+}
+
+//Runs as each conversion finishes. In free running mode the next conversion
+//has already started on the channel the multiplexer was set to, so the
+//multiplexer is moved on to the channel after that.
+ISR(ADC_vect)
+{
+  uint8_t index = resultChannel;
+  uint8_t write = readBuffer ^ 1;
+  samples[write][index] = ADC;
+  if(index == JOYSTICK_CHANNELS - 1)
+  {
+    readBuffer = write;
+    rounds++;
+  }
+  
+  resultChannel = muxChannel;
+  muxChannel = (muxChannel + 1) % JOYSTICK_CHANNELS;
+  selectChannel(muxChannel);
+}
+
+//The latest reading of each joystick, 0 to 1023. Takes no time, the readings
+//are already there. A swap while copying means the set is being refilled, so
+//copy the new one instead.
+void readJoystickAdc(AxisSettings *inputs)
+{
+  unsigned long round;
+  do
+  {
+    round = joystickAdcRounds();
+    volatile int *sample = samples[readBuffer];
+    inputs->x = sample[0];
+    inputs->y = sample[1];
+    inputs->z = sample[2];
+  } while(round != joystickAdcRounds());
+}
+
+//Number of complete sets of readings so far.
+unsigned long joystickAdcRounds()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = rounds;
+  SREG = oldSREG;
+  return count;
+}
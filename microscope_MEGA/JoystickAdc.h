@@ -0,0 +1,29 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef JoystickAdc_h
+#define JoystickAdc_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+#include "AsiSettings.h"
+
+//The ADC runs free with a clock of F_CPU / 128, 125kHz, the fastest that
+//still gives the full 10 bits. Each conversion takes 13 ADC clocks, so each
+//of the three joysticks is read about 3200 times a second.
+#define JOYSTICK_ADC_PRESCALE (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))
+
+//Readings are taken by the ADC interupt one channel after another, so
+//analogRead() can't be used once the joysticks are started.
+void startJoystickAdc(int xPin, int yPin, int zPin);
+void readJoystickAdc(AxisSettings *inputs);
+unsigned long joystickAdcRounds();
+
+#endif
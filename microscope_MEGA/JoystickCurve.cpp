@@ -0,0 +1,102 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "JoystickCurve.h"
+#include <avr/pgmspace.h>
+
+//Shapes of the slow half of the joystick travel, from the center to half
+//deflection, as fractions of the slow speed out of 65535.
+//speed in proportion to the deflection.
+static const uint16_t linearShape[JOYSTICK_SHAPE_POINTS] PROGMEM = {
+  0, 1024, 2048, 3072, 4096, 5120, 6144, 7168, 8192,
+  9216, 10240, 11264, 12288, 13312, 14336, 15360, 16384, 17408,
+  18432, 19456, 20480, 21504, 22528, 23552, 24576, 25600, 26624,
+  27648, 28672, 29696, 30720, 31744, 32768, 33791, 34815, 35839,
+  36863, 37887, 38911, 39935, 40959, 41983, 43007, 44031, 45055,
+  46079, 47103, 48127, 49151, 50175, 51199, 52223, 53247, 54271,
+  55295, 56319, 57343, 58367, 59391, 60415, 61439, 62463, 63487,
+  64511, 65535
+};
+
+//speed with the square of the deflection.
+static const uint16_t quadraticShape[JOYSTICK_SHAPE_POINTS] PROGMEM = {
+  0, 16, 64, 144, 256, 400, 576, 784, 1024,
+  1296, 1600, 1936, 2304, 2704, 3136, 3600, 4096, 4624,
+  5184, 5776, 6400, 7056, 7744, 8464, 9216, 10000, 10816,
+  11664, 12544, 13456, 14400, 15376, 16384, 17424, 18496, 19600,
+  20736, 21904, 23104, 24336, 25600, 26896, 28224, 29584, 30976,
+  32400, 33855, 35343, 36863, 38415, 39999, 41615, 43263, 44943,
+  46655, 48399, 50175, 51983, 53823, 55695, 57599, 59535, 61503,
+  63503, 65535
+};
+
+//speed with the cube of the deflection, the finest near the center.
+static const uint16_t cubicShape[JOYSTICK_SHAPE_POINTS] PROGMEM = {
+  0, 0, 2, 7, 16, 31, 54, 86, 128,
+  182, 250, 333, 432, 549, 686, 844, 1024, 1228,
+  1458, 1715, 2000, 2315, 2662, 3042, 3456, 3906, 4394,
+  4921, 5488, 6097, 6750, 7448, 8192, 8984, 9826, 10719,
+  11664, 12663, 13718, 14830, 16000, 17230, 18522, 19876, 21296,
+  22781, 24334, 25955, 27648, 29412, 31250, 33162, 35151, 37219,
+  39365, 41593, 43903, 46298, 48777, 51344, 53999, 56744, 59581,
+  62511, 65535
+};
+
+//Speed for each step of the input, in steps per second. Worked out from the
+//shape and the JSSPD speeds whenever they change, so setting a speed from
+//the joystick is only a lookup.
+static uint16_t rates[JOYSTICK_RATES];
+
+//Fraction of the slow speed, out of 65535, at point i of the slow half for
+//straight lines through 0, userThird and userTwoThirds percent and 100.
+static uint16_t userShape(int i, long userThird, long userTwoThirds)
+{
+  const long last = JOYSTICK_SHAPE_POINTS - 1;
+  long points[4] = {0, userThird, userTwoThirds, 100};
+  long part = min(i * 3 / last, 2L);
+  long from = part * last;
+  long percent = points[part] * last + (points[part + 1] - points[part]) * (i * 3 - from);
+  return constrain(percent * 65535L / (100 * last), 0L, 65535L);
+}
+
+//Work out the speed table. From the center to half deflection the speed
+//follows the curve up to slowRate, then rises in a straight line to fastRate
+//at full deflection. Inside the dead zone it is 0.
+void buildJoystickRates(int curve, long userThird, long userTwoThirds, int deadZone, long slowRate, long fastRate)
+{
+  const uint16_t *shape = quadraticShape;
+  if(curve == JOYSTICK_CURVE_LINEAR){shape = linearShape;}
+  if(curve == JOYSTICK_CURVE_CUBIC){shape = cubicShape;}
+  
+  const int half = JOYSTICK_SHAPE_POINTS - 1;
+  for(int i = 0; i < JOYSTICK_RATES; i++)
+  {
+    long rate;
+    if(i <= half)
+    {
+      uint16_t fraction = curve == JOYSTICK_CURVE_USER ? userShape(i, userThird, userTwoThirds)
+                                                       : pgm_read_word(&shape[i]);
+      rate = slowRate * fraction / 65535L;
+    }
+    else
+    {
+      rate = slowRate + (fastRate - slowRate) * (i - half) / half;
+    }
+    if((i << JOYSTICK_RATE_SHIFT) <= deadZone)
+    {
+      rate = 0;
+    }
+    rates[i] = rate;
+  }
+}
+
+//Signed speed for a centered input.
+long joystickRate(long input)
+{
+  long rate = rates[min(labs(input), (long)JOYSTICK_FULL) >> JOYSTICK_RATE_SHIFT];
+  return input < 0 ? -rate : rate;
+}
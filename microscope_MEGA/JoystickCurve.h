@@ -0,0 +1,35 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef JoystickCurve_h
+#define JoystickCurve_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+
+//JSCURVE X= shapes for the slow half of the joystick travel.
+#define JOYSTICK_CURVE_LINEAR 0
+#define JOYSTICK_CURVE_QUADRATIC 1
+#define JOYSTICK_CURVE_CUBIC 2
+#define JOYSTICK_CURVE_USER 3//straight lines through JSCURVE Y= and Z=.
+
+//Full deflection of a centered joystick input.
+#define JOYSTICK_FULL 512
+
+//The speeds are looked up in steps of this many input counts, the shapes
+//have one point for each step of the slow half.
+#define JOYSTICK_RATE_SHIFT 2
+#define JOYSTICK_RATES ((JOYSTICK_FULL >> JOYSTICK_RATE_SHIFT) + 1)
+#define JOYSTICK_SHAPE_POINTS (JOYSTICK_RATES / 2 + 1)
+
+void buildJoystickRates(int curve, long userThird, long userTwoThirds, int deadZone, long slowRate, long fastRate);
+long joystickRate(long input);
+
+#endif
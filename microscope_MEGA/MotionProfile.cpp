@@ -0,0 +1,227 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "MotionProfile.h"
+
+//Work out the length and shape of one ramp from fromRate to toRate.
+static void planRamp(float fromRate, float toRate, long accelRate, int sCurve, long ticksPerSec, long *ticks, long *accel, long *jerk)
+{
+  long rampTicks = (long)(fabs(toRate - fromRate) * ticksPerSec / accelRate);
+  long delta = (long)(fabs(toRate - fromRate) * RATE_SCALE);
+  *accel = 0;
+  *jerk = 0;
+  if(sCurve && rampTicks >= 2)
+  {
+    long halfTicks = rampTicks / 2;
+    rampTicks = halfTicks * 2;
+    *jerk = (delta << ACCEL_SHIFT) / (halfTicks * halfTicks);
+  }
+  else if(rampTicks > 0)
+  {
+    *accel = (delta << ACCEL_SHIFT) / rampTicks;
+  }
+  *ticks = rampTicks;
+}
+
+//Work out the profile for a move of steps (always positive).
+//entryRate and exitRate are the speeds the move joins the moves before and
+//after it at, 0 to start or finish standing still. cruiseRate is the top
+//speed in steps per second, accelRate the average acceleration in steps per
+//second per second, sCurve selects the jerk limited ramp and ticksPerSec is
+//the number of profile ticks per second.
+//Both ramp shapes take the same time, the S-curve just eases in and out.
+//Runs in the foreground, so floating point is fine here.
+void planProfile(MotionProfile *profile, long steps, long entryRate, long cruiseRate, long exitRate, long accelRate, int sCurve, long ticksPerSec)
+{
+  profile->stepsRemaining = steps;
+  profile->decelSteps = 0;
+  profile->rate = 0;
+  profile->endRate = 0;
+  profile->cruiseRate = 0;
+  profile->upAccel = 0;
+  profile->downAccel = 0;
+  profile->upJerk = 0;
+  profile->downJerk = 0;
+  profile->upTicks = 0;
+  profile->downTicks = 0;
+  profile->accel = 0;
+  profile->tick = 0;
+  profile->phase = PROFILE_IDLE;
+  if(steps <= 0 || cruiseRate <= 0)
+  {
+    profile->stepsRemaining = 0;
+    return;
+  }
+
+  if(accelRate <= 0)
+  {
+    accelRate = cruiseRate * ticksPerSec;//no ramp, full speed in one tick.
+  }
+
+  //start and stop at no less than the speed reached after accelerating over a single step.
+  float minRate = sqrt(2.0 * accelRate);
+  if(minRate > cruiseRate)
+  {
+    minRate = cruiseRate;
+  }
+  float startRate = constrain((float)entryRate, minRate, (float)cruiseRate);
+  float endRate = constrain((float)exitRate, minRate, (float)cruiseRate);
+
+  float peakRate = cruiseRate;
+  if(((float)cruiseRate * cruiseRate * 2.0 - startRate * startRate - endRate * endRate) / (2.0 * accelRate) > steps)
+  {
+    //too short to reach cruise speed, ramp up and straight back down.
+    peakRate = sqrt((float)accelRate * steps + (startRate * startRate + endRate * endRate) / 2.0);
+  }
+  peakRate = max(peakRate, max(startRate, endRate));
+
+  planRamp(startRate, peakRate, accelRate, sCurve, ticksPerSec, &profile->upTicks, &profile->upAccel, &profile->upJerk);
+  planRamp(peakRate, endRate, accelRate, sCurve, ticksPerSec, &profile->downTicks, &profile->downAccel, &profile->downJerk);
+
+  //the ramps are symmetric about their middle so the average speed gives the steps.
+  profile->decelSteps = (long)((endRate + peakRate) / 2.0 * profile->downTicks / ticksPerSec);
+  profile->endRate = (long)(endRate * RATE_SCALE);
+  profile->cruiseRate = (long)(peakRate * RATE_SCALE);
+  profile->accel = profile->upAccel;
+  if(profile->upTicks > 0)
+  {
+    profile->rate = (long)(startRate * RATE_SCALE);
+    profile->phase = PROFILE_RAMP_UP;
+  }
+  else
+  {
+    profile->rate = profile->cruiseRate;
+    profile->phase = PROFILE_CRUISE;
+  }
+}
+
+//Move the acceleration along a ramp. Jerk is added for the first half
+//of the ramp and taken away for the second. Trapezoids have no jerk.
+static void rampAccel(MotionProfile *profile, long jerk, long rampTicks)
+{
+  if(profile->tick < rampTicks / 2)
+  {
+    profile->accel += jerk;
+  }
+  else
+  {
+    profile->accel -= jerk;
+  }
+  profile->tick++;
+}
+
+//Advance the ramp by one tick and return the speed in steps per second.
+long profileTick(MotionProfile *profile)
+{
+  if(profile->stepsRemaining <= 0)
+  {
+    profile->phase = PROFILE_IDLE;
+    return 0;
+  }
+
+  if((profile->phase == PROFILE_RAMP_UP || profile->phase == PROFILE_CRUISE) &&
+     profile->stepsRemaining <= profile->decelSteps)
+  {
+    profile->phase = PROFILE_RAMP_DOWN;
+    profile->tick = 0;
+    profile->accel = profile->downAccel;
+  }
+
+  if(profile->phase == PROFILE_RAMP_UP)
+  {
+    rampAccel(profile, profile->upJerk, profile->upTicks);
+    profile->rate += profile->accel >> ACCEL_SHIFT;
+    if(profile->tick >= profile->upTicks)
+    {
+      profile->rate = profile->cruiseRate;
+      profile->phase = PROFILE_CRUISE;
+    }
+  }
+  else if(profile->phase == PROFILE_RAMP_DOWN)
+  {
+    rampAccel(profile, profile->downJerk, profile->downTicks);
+    profile->rate -= profile->accel >> ACCEL_SHIFT;
+    if(profile->rate < profile->endRate || profile->tick >= profile->downTicks)
+    {
+      profile->rate = profile->endRate;
+      profile->phase = PROFILE_STOPPING;
+    }
+  }
+
+  return profile->rate >> RATE_SHIFT;
+}
+
+static void planLineAxis(LineAxis *axis, long steps, long total)
+{
+  axis->steps = steps;
+  axis->error = total / 2;//centred, so the steps fall evenly along the line.
+}
+
+//Set up a straight line move of x, y and z steps (all positive).
+void planLine(LineMove *line, long x, long y, long z)
+{
+  line->lead = AXIS_X;
+  line->total = x;
+  if(y > line->total)
+  {
+    line->lead = AXIS_Y;
+    line->total = y;
+  }
+  if(z > line->total)
+  {
+    line->lead = AXIS_Z;
+    line->total = z;
+  }
+  planLineAxis(&line->x, x, line->total);
+  planLineAxis(&line->y, y, line->total);
+  planLineAxis(&line->z, z, line->total);
+}
+
+//Copy a planned line into the one the interupt is using.
+//Call from the interupt or with interupts disabled.
+void loadLine(volatile LineMove *to, LineMove *from)
+{
+  to->x.steps = from->x.steps;
+  to->x.error = from->x.error;
+  to->y.steps = from->y.steps;
+  to->y.error = from->y.error;
+  to->z.steps = from->z.steps;
+  to->z.error = from->z.error;
+  to->total = from->total;
+  to->lead = from->lead;
+}
+
+//Called on every tick of the lead axis. Returns true if this axis steps too.
+int isLineStepDue(volatile LineAxis *axis, long total)
+{
+  axis->error += axis->steps;
+  if(axis->error >= total)
+  {
+    axis->error -= total;
+    return true;
+  }
+  return false;
+}
+
+//Set up a ramp down from rate (steps per second) at accelRate (steps per
+//second per second). With no acceleration it stops on the first tick.
+void planStopRamp(volatile StopRamp *ramp, long rate, long accelRate, long ticksPerSec)
+{
+  ramp->rate = rate;
+  ramp->step = accelRate > 0 ? max(accelRate / ticksPerSec, 1L) : rate;
+}
+
+//Called once a tick. Returns the new rate, 0 once stopped.
+long stopRampTick(volatile StopRamp *ramp)
+{
+  ramp->rate -= ramp->step;
+  if(ramp->rate < 0)
+  {
+    ramp->rate = 0;
+  }
+  return ramp->rate;
+}
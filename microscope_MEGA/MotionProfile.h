@@ -0,0 +1,95 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef MotionProfile_h
+#define MotionProfile_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+
+//Profile rates are kept in steps per second multiplied by RATE_SCALE so slow
+//ramps still have a non zero change per tick.
+#define RATE_SHIFT 8
+#define RATE_SCALE (1L << RATE_SHIFT)
+
+//Acceleration and jerk carry ACCEL_SHIFT more bits than the rate so long
+//S-curve ramps at low speed don't round the jerk down to nothing.
+#define ACCEL_SHIFT 8
+
+//Profile phases.
+#define PROFILE_IDLE 0
+#define PROFILE_RAMP_UP 1
+#define PROFILE_CRUISE 2
+#define PROFILE_RAMP_DOWN 3
+#define PROFILE_STOPPING 4
+
+//Speed ramp for one axis of a move. Everything is worked out in planProfile()
+//so each tick only has to add, subtract and compare.
+//A trapezoidal ramp has no jerk and a constant acceleration. An S-curve ramp
+//starts with no acceleration, adds jerk for the first half of the ramp and
+//takes it away for the second half.
+//A move can start and end at speed when it joins another move, so the ramp up
+//and the ramp down each have their own length.
+struct MotionProfile {
+  long stepsRemaining;//steps left before the axis reaches the target.
+  long decelSteps;//start slowing down when this many steps are left.
+  long rate;//current speed.
+  long endRate;//speed at the end of the move.
+  long cruiseRate;//top speed.
+  long upAccel;//acceleration at the start of the ramp up.
+  long downAccel;//acceleration at the start of the ramp down.
+  long upJerk;//change in acceleration per tick on the ramp up.
+  long downJerk;
+  long upTicks;//ticks in the ramp up.
+  long downTicks;
+  long accel;//current acceleration.
+  long tick;//ticks into the current ramp.
+  int phase;
+};
+
+//Axis numbers.
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+
+//One axis of a straight line move.
+struct LineAxis {
+  long steps;//steps this axis makes over the whole move.
+  long error;//Bresenham error term.
+};
+
+//Straight line through all the axes of a move. The lead axis, the one with
+//the most steps, steps on every tick and follows the speed ramp. The others
+//step whenever their error term rolls over, so they keep in proportion and
+//every axis arrives on the same tick.
+struct LineMove {
+  LineAxis x;
+  LineAxis y;
+  LineAxis z;
+  long total;//steps of the lead axis.
+  int lead;
+};
+
+//Ramp down to a stop at a steady acceleration, for a HALT. It runs in the
+//ramp interupt, so each tick only subtracts.
+struct StopRamp {
+  long rate;//steps per second.
+  long step;//taken off the rate each tick.
+};
+
+void planProfile(MotionProfile *profile, long steps, long entryRate, long cruiseRate, long exitRate, long accelRate, int sCurve, long ticksPerSec);
+long profileTick(MotionProfile *profile);
+void planLine(LineMove *line, long x, long y, long z);
+void loadLine(volatile LineMove *to, LineMove *from);
+int isLineStepDue(volatile LineAxis *axis, long total);
+void planStopRamp(volatile StopRamp *ramp, long rate, long accelRate, long ticksPerSec);
+long stopRampTick(volatile StopRamp *ramp);
+
+#endif
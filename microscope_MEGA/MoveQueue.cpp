@@ -0,0 +1,194 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "MoveQueue.h"
+#include "StepTimer.h"
+
+//Ring buffer of moves. Commands add at the head and the segment buffer takes
+//from the tail, both in the foreground.
+static MoveBlock blocks[MOVE_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueTail = 0;
+
+//Set while the move last taken is being cut into segments. Its ramp can't
+//change any more, so the next move has to start at the speed it ends at.
+static int moveRunning = false;
+static float runningExitSpeed = 0;
+
+static uint8_t nextIndex(uint8_t index)
+{
+  return (index + 1) % MOVE_QUEUE_SIZE;
+}
+
+static uint8_t previousIndex(uint8_t index)
+{
+  return (index + MOVE_QUEUE_SIZE - 1) % MOVE_QUEUE_SIZE;
+}
+
+//Number of moves that can still be queued.
+int moveQueueSpace()
+{
+  return (queueTail + MOVE_QUEUE_SIZE - 1 - queueHead) % MOVE_QUEUE_SIZE;
+}
+
+int moveQueueEmpty()
+{
+  return queueHead == queueTail;
+}
+
+//Fastest speed the corner from the line before into this one can be taken at.
+//The corner is treated as an arc that stays within JUNCTION_DEVIATION of the
+//vertex, with the centripetal acceleration limited to the move's acceleration.
+static float junctionSpeed(MoveBlock *before, MoveBlock *block)
+{
+  float cosTheta = -(before->unit.x * block->unit.x +
+                     before->unit.y * block->unit.y +
+                     before->unit.z * block->unit.z);
+  float speed = min(before->nominalSpeed, block->nominalSpeed);
+  if(cosTheta < -0.999)
+  {
+    return speed;//straight on.
+  }
+  if(cosTheta > 0.999)
+  {
+    return 0;//straight back.
+  }
+  float sinHalfTheta = sqrt(0.5 * (1.0 - cosTheta));
+  float accel = min(before->accel, block->accel);
+  return min(speed, sqrt(accel * JUNCTION_DEVIATION * sinHalfTheta / (1.0 - sinHalfTheta)));
+}
+
+//Fastest a move can be entered and still slow down to exitSpeed by its end.
+static float maxAllowedSpeed(MoveBlock *block, float exitSpeed)
+{
+  return sqrt(exitSpeed * exitSpeed + 2.0 * block->accel * block->length);
+}
+
+//Plan the lead axis ramp for a move between two line speeds.
+static void planBlockProfile(MoveBlock *block, float entrySpeed, float exitSpeed, long ticksPerSec)
+{
+  float leadRatio = block->line.total / block->length;
+  planProfile(&block->profile, block->line.total,
+              (long)(entrySpeed * leadRatio),
+              (long)(block->nominalSpeed * leadRatio),
+              (long)(exitSpeed * leadRatio),
+              (long)(block->accel * leadRatio),
+              block->sCurve, ticksPerSec);
+  block->exitSpeed = exitSpeed;
+}
+
+//Go over every move that hasn't started and work out the speed at each corner.
+//Working back from a stop after the last move, each move must be entered slowly
+//enough to slow down for the next corner. Working forward from the speed the
+//running move will finish at, each move must be entered no faster than the one
+//before could reach.
+static void planQueue(long ticksPerSec)
+{
+  float entry[MOVE_QUEUE_SIZE];
+  uint8_t last = previousIndex(queueHead);
+
+  //backward pass, the last move ends standing still.
+  float nextEntry = 0;
+  for(uint8_t i = last; ; i = previousIndex(i))
+  {
+    if(i == queueTail)
+    {
+      entry[i] = moveRunning ? runningExitSpeed : 0;
+      break;
+    }
+    entry[i] = min(blocks[i].maxEntrySpeed, maxAllowedSpeed(&blocks[i], nextEntry));
+    nextEntry = entry[i];
+  }
+
+  //forward pass.
+  for(uint8_t i = queueTail; i != last; i = nextIndex(i))
+  {
+    uint8_t next = nextIndex(i);
+    entry[next] = min(entry[next], maxAllowedSpeed(&blocks[i], entry[i]));
+    planBlockProfile(&blocks[i], entry[i], entry[next], ticksPerSec);
+  }
+  planBlockProfile(&blocks[last], entry[last], 0, ticksPerSec);
+}
+
+//Add a straight line move of steps to the queue and replan the queue.
+//speed is the line speed in steps per second, accelTime the time in ms to get
+//up to it. trigger pulses the TTL output as the move starts.
+//Only call when there is space in the queue.
+void queueMove(AxisSettings *steps, float speed, long accelTime, int sCurve, int trigger, long ticksPerSec)
+{
+  MoveBlock *block = &blocks[queueHead];
+  block->steps = *steps;
+  planLine(&block->line, labs(steps->x), labs(steps->y), labs(steps->z));
+  block->length = sqrt((float)steps->x * steps->x + (float)steps->y * steps->y + (float)steps->z * steps->z);
+  if(block->length == 0)
+  {
+    return;
+  }
+  block->unit.x = steps->x / block->length;
+  block->unit.y = steps->y / block->length;
+  block->unit.z = steps->z / block->length;
+  block->nominalSpeed = max(min(speed, MAX_STEP_RATE * block->length / block->line.total), 1.0);
+  if(accelTime > 0)
+  {
+    block->accel = block->nominalSpeed * 1000.0 / accelTime;
+  }
+  else
+  {
+    block->accel = block->nominalSpeed * ticksPerSec;
+  }
+  block->sCurve = sCurve;
+  block->trigger = trigger;
+
+  //the move before is still in its slot, whether it is waiting or running.
+  block->maxEntrySpeed = 0;
+  if(moveRunning || !moveQueueEmpty())
+  {
+    block->maxEntrySpeed = junctionSpeed(&blocks[previousIndex(queueHead)], block);
+  }
+
+  queueHead = nextIndex(queueHead);
+  planQueue(ticksPerSec);
+}
+
+//Take the next move off the queue, with its ramp planned and the lead axis
+//acceleration in steps per second per second. Returns false if the queue is empty.
+int takeMove(MotionProfile *profile, LineMove *line, AxisSettings *steps, int *trigger, long *accel)
+{
+  if(moveQueueEmpty())
+  {
+    moveRunning = false;
+    return false;
+  }
+  MoveBlock *block = &blocks[queueTail];
+  *profile = block->profile;
+  *line = block->line;
+  *steps = block->steps;
+  *trigger = block->trigger;
+  *accel = (long)(block->accel * block->line.total / block->length);
+  runningExitSpeed = block->exitSpeed;
+  moveRunning = true;
+  queueTail = nextIndex(queueTail);
+  return true;
+}
+
+//Drop every move that hasn't been taken yet.
+void clearMoveQueue()
+{
+  queueTail = queueHead;
+}
+
+//Steps of the anti-backlash approach for an axis, 0 if it finishes
+//moving in the positive direction anyway or has no BACKLASH set.
+//backlash and overshoot are in mm.
+long approachSteps(long steps, float backlash, float overshoot, float stepsPerMm)
+{
+  if(steps >= 0 || backlash <= 0)
+  {
+    return 0;
+  }
+  return (long)((backlash + max(overshoot, 0)) * stepsPerMm + 0.5);
+}
@@ -0,0 +1,50 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef MoveQueue_h
+#define MoveQueue_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+#include "AsiSettings.h"
+#include "MotionProfile.h"
+
+//Number of moves that can wait behind the one running. One slot is always
+//left empty to tell a full queue from an empty one.
+#define MOVE_QUEUE_SIZE 8
+
+//How far in steps the stage may cut inside a corner between two moves.
+//Sets the speed each corner is taken at, sharper corners are taken slower.
+#define JUNCTION_DEVIATION 10.0
+
+//A straight line move waiting in the queue. Speeds are along the line in
+//steps per second, the profile is for the lead axis.
+struct MoveBlock {
+  AxisSettings steps;//signed steps for each axis.
+  AxisSettingsF unit;//direction of the line.
+  float length;//length of the line in steps.
+  float nominalSpeed;//speed to cruise at.
+  float accel;//steps per second per second.
+  float maxEntrySpeed;//fastest the corner with the move before can be taken.
+  float exitSpeed;//planned speed at the end, the start speed of the next move.
+  int sCurve;
+  int trigger;//pulse the TTL output on the first step.
+  LineMove line;
+  MotionProfile profile;
+};
+
+int moveQueueSpace();
+int moveQueueEmpty();
+void queueMove(AxisSettings *steps, float speed, long accelTime, int sCurve, int trigger, long ticksPerSec);
+int takeMove(MotionProfile *profile, LineMove *line, AxisSettings *steps, int *trigger, long *accel);
+void clearMoveQueue();
+long approachSteps(long steps, float backlash, float overshoot, float stepsPerMm);
+
+#endif
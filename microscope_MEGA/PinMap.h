@@ -0,0 +1,59 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef PinMap_h
+#define PinMap_h
+
+#include <avr/io.h>
+
+//Compile time map from Arduino MEGA pin numbers to port registers and bit masks.
+//With a constant pin the compiler folds these down to a single port access,
+//where digitalWrite() looks the pin up in flash tables on every call.
+//Only for the ATmega1280/2560 pinout.
+
+#define PIN_PORT(pin) ( \
+  (pin) <= 3 ? &PORTE : \
+  (pin) == 4 ? &PORTG : \
+  (pin) == 5 ? &PORTE : \
+  (pin) <= 9 ? &PORTH : \
+  (pin) <= 13 ? &PORTB : \
+  (pin) <= 15 ? &PORTJ : \
+  (pin) <= 17 ? &PORTH : \
+  (pin) <= 21 ? &PORTD : \
+  (pin) <= 29 ? &PORTA : \
+  (pin) <= 37 ? &PORTC : \
+  (pin) == 38 ? &PORTD : \
+  (pin) <= 41 ? &PORTG : \
+  (pin) <= 49 ? &PORTL : \
+  (pin) <= 53 ? &PORTB : \
+  (pin) <= 61 ? &PORTF : &PORTK)
+
+#define PIN_BIT(pin) ( \
+  (pin) <= 1 ? (pin) : \
+  (pin) <= 3 ? (pin) + 2 : \
+  (pin) == 4 ? 5 : \
+  (pin) == 5 ? 3 : \
+  (pin) <= 9 ? (pin) - 3 : \
+  (pin) <= 13 ? (pin) - 6 : \
+  (pin) <= 15 ? 15 - (pin) : \
+  (pin) <= 17 ? 17 - (pin) : \
+  (pin) <= 21 ? 21 - (pin) : \
+  (pin) <= 29 ? (pin) - 22 : \
+  (pin) <= 37 ? 37 - (pin) : \
+  (pin) == 38 ? 7 : \
+  (pin) <= 41 ? 41 - (pin) : \
+  (pin) <= 49 ? 49 - (pin) : \
+  (pin) <= 53 ? 53 - (pin) : \
+  (pin) <= 61 ? (pin) - 54 : (pin) - 62)
+
+#define PIN_MASK(pin) ((uint8_t)_BV(PIN_BIT(pin)))
+
+//The input register sits two below the output register on every port.
+#define PIN_INPUT(pin) (PIN_PORT(pin) - 2)
+
+#endif
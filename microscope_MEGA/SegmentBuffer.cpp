@@ -0,0 +1,149 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "SegmentBuffer.h"
+#include "MoveQueue.h"
+#include "StepTimer.h"
+
+//Ring buffer of segments. The foreground fills the slot at the head and only
+//then moves the head on, the step interupt reads the slot at the tail and
+//then moves the tail on. The indexes are single bytes so neither side needs
+//to hold the interupts off to read the other's. The slots themselves aren't
+//volatile, so a compiler barrier keeps the slot writes before the head moves
+//on and the slot reads before the tail does.
+static MoveSegment segments[SEGMENT_BUFFER_SIZE];
+static LineMove segmentLines[SEGMENT_BUFFER_SIZE];//line for each newLine segment.
+static volatile uint8_t segmentHead = 0;
+static volatile uint8_t segmentTail = 0;
+
+//The move being cut into segments.
+static MotionProfile prepProfile;
+static LineMove prepLine;
+static uint8_t prepDirections = 0;
+static int preparing = false;
+static int prepNewLine = false;
+static int prepTrigger = false;
+static long prepAccel = 0;
+static long stepFraction = 0;//lead axis steps carried over between ticks, times RATE_SCALE * ticksPerSec.
+
+static uint8_t nextSegmentIndex(uint8_t index)
+{
+  return (index + 1) % SEGMENT_BUFFER_SIZE;
+}
+
+static int segmentBufferFull()
+{
+  return nextSegmentIndex(segmentHead) == segmentTail;
+}
+
+//Take the next move off the queue to cut into segments.
+static int startPreparing()
+{
+  AxisSettings steps;
+  if(!takeMove(&prepProfile, &prepLine, &steps, &prepTrigger, &prepAccel))
+  {
+    return false;
+  }
+  prepDirections = 0;
+  if(steps.x > 0){prepDirections |= SEGMENT_DIR(AXIS_X);}
+  if(steps.y > 0){prepDirections |= SEGMENT_DIR(AXIS_Y);}
+  if(steps.z > 0){prepDirections |= SEGMENT_DIR(AXIS_Z);}
+  prepNewLine = true;
+  stepFraction = 0;
+  preparing = true;
+  return true;
+}
+
+//Fill the segment buffer from the move queue. Runs the lead axis profile one
+//tick at a time and turns the speed of each tick into a step count and a step
+//interval, so all the division happens here rather than in the interupt.
+//A tick too slow for a whole step is run together with the next one.
+//Call often from loop().
+void prepareSegments(long ticksPerSec)
+{
+  long stepsPerTick = RATE_SCALE * ticksPerSec;
+  while(!segmentBufferFull())
+  {
+    if(!preparing && !startPreparing())
+    {
+      return;
+    }
+
+    long steps = 0;
+    while(steps == 0)
+    {
+      profileTick(&prepProfile);
+      stepFraction += max(prepProfile.rate, 1L);
+      steps = stepFraction / stepsPerTick;
+      stepFraction -= steps * stepsPerTick;
+    }
+    if(steps >= prepProfile.stepsRemaining)
+    {
+      steps = prepProfile.stepsRemaining;
+      preparing = false;
+    }
+    prepProfile.stepsRemaining -= steps;
+
+    uint8_t index = segmentHead;
+    MoveSegment *segment = &segments[index];
+    segment->steps = steps;
+    segment->interval = F_CPU / constrain(prepProfile.rate >> RATE_SHIFT, 1L, MAX_STEP_RATE);
+    segment->directions = prepDirections;
+    segment->newLine = prepNewLine;
+    segment->trigger = prepTrigger;
+    segment->accel = prepAccel;
+    if(prepNewLine)
+    {
+      segmentLines[index] = prepLine;
+      prepNewLine = false;
+      prepTrigger = false;
+    }
+    asm volatile("" ::: "memory");
+    segmentHead = nextSegmentIndex(index);
+  }
+}
+
+//Throw away the segments the interupt hasn't taken and the rest of the move
+//being prepared. Clear the move queue first.
+void stopSegments()
+{
+  preparing = false;
+  noInterrupts();
+  segmentTail = segmentHead;
+  interrupts();
+}
+
+//True while any part of a move is still to be handed to the interupt.
+int moveSegmentsPending()
+{
+  return preparing || segmentHead != segmentTail || !moveQueueEmpty();
+}
+
+//Called by the step interupt to get the next segment, and its line if it
+//starts one. Returns false if the buffer is empty.
+int takeSegment(volatile MoveSegment *segment, volatile LineMove *line)
+{
+  uint8_t index = segmentTail;
+  if(index == segmentHead)
+  {
+    return false;
+  }
+  MoveSegment *from = &segments[index];
+  segment->steps = from->steps;
+  segment->interval = from->interval;
+  segment->directions = from->directions;
+  segment->newLine = from->newLine;
+  segment->trigger = from->trigger;
+  segment->accel = from->accel;
+  if(from->newLine)
+  {
+    loadLine(line, &segmentLines[index]);
+  }
+  asm volatile("" ::: "memory");
+  segmentTail = nextSegmentIndex(index);
+  return true;
+}
@@ -0,0 +1,42 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef SegmentBuffer_h
+#define SegmentBuffer_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+#include "MotionProfile.h"
+
+//Number of segments that can wait for the step interupt. Each one lasts
+//about one tick of the profile, so this is how far the foreground can fall
+//behind before the stage stutters. One slot is always left empty.
+#define SEGMENT_BUFFER_SIZE 12
+
+//Direction bits of a segment, one per axis, set for the positive direction.
+#define SEGMENT_DIR(axis) (1 << (axis))
+
+//A piece of a move at one speed, worked out in the foreground. The step
+//interupt only counts the lead axis steps off and loads the next segment.
+struct MoveSegment {
+  long steps;//lead axis steps in the segment.
+  unsigned long interval;//timer cycles between them.
+  uint8_t directions;//SEGMENT_DIR bits.
+  uint8_t newLine;//true on the first segment of a line, which comes with the line.
+  uint8_t trigger;//pulse the TTL output with the first step.
+  long accel;//lead axis steps per second per second of the move, to halt it at.
+};
+
+void prepareSegments(long ticksPerSec);
+int moveSegmentsPending();
+void stopSegments();
+int takeSegment(volatile MoveSegment *segment, volatile LineMove *line);
+
+#endif
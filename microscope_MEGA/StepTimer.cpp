@@ -0,0 +1,179 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include "StepTimer.h"
+
+static void resetStepTimer(volatile StepTimer *timer, Timer16 *hardware, char channel, char pulses)
+{
+  timer->lastRate = 0;
+  timer->lastInterval = 0;
+  timer->interval = 0;
+  timer->wait = 0;
+  timer->timer = hardware;
+  timer->channel = channel;
+  timer->pulses = pulses;
+}
+
+//Time an axis on a compare channel of a free running timer.
+//isr is called on every compare match.
+void attachStepTimer(volatile StepTimer *timer, Timer16 *hardware, char channel, void (*isr)())
+{
+  resetStepTimer(timer, hardware, channel, false);
+  hardware->attachCompareInterrupt(channel, isr);
+}
+
+//Give an axis a timer of its own that makes the pulses on the output pin of
+//channel. isr is called at the end of every pulse.
+void attachPulseTimer(volatile StepTimer *timer, Timer16 *hardware, char channel, void (*isr)())
+{
+  resetStepTimer(timer, hardware, channel, true);
+  hardware->initializePulses(channel);
+  hardware->attachCompareInterrupt(channel, isr);
+}
+
+//Move the compare register on by the next hop of the wait.
+//A hop that has already been passed is put just ahead of the counter instead,
+//the step is late but the axis keeps going.
+static void advanceCompare(volatile StepTimer *timer)
+{
+  Timer16 *hardware = timer->timer;
+  volatile uint16_t *compare = hardware->compareRegister(timer->channel);
+  unsigned int hop = timer->wait > 0xFFFF ? STEP_HOP : timer->wait;
+  unsigned int late = hardware->read() - *compare;
+  timer->wait -= hop;
+  if(late + STEP_LEAD >= hop)
+  {
+    *compare = hardware->read() + STEP_LEAD;
+  }
+  else
+  {
+    *compare += hop;
+  }
+}
+
+//Timer cycles between steps for a speed in steps per second, 0 to stop.
+//The division is slow, so it is skipped while the speed stays the same.
+//Only call from the one place that sets the speed of the axis.
+unsigned long stepInterval(volatile StepTimer *timer, long rate)
+{
+  if(rate != timer->lastRate)
+  {
+    timer->lastRate = rate;
+    if(rate <= 0)
+    {
+      timer->lastInterval = 0;
+    }
+    else
+    {
+      timer->lastInterval = F_CPU / min(rate, MAX_STEP_RATE);
+    }
+  }
+  return timer->lastInterval;
+}
+
+//Change the interval of an axis. A stopped axis takes its first step straight
+//away, a running one uses the new interval from its next step on.
+//Call from an interupt or with interupts disabled.
+void setStepInterval(volatile StepTimer *timer, unsigned long interval)
+{
+  if(interval == 0)
+  {
+    stopStepTimer(timer);
+  }
+  else if(timer->interval == 0)
+  {
+    timer->interval = interval;
+    timer->wait = 0;
+    if(timer->pulses)
+    {
+      timer->timer->startPulses(interval);
+    }
+    else
+    {
+      timer->timer->enableCompare(timer->channel, timer->timer->read() + STEP_LEAD);
+    }
+  }
+  else
+  {
+    //don't sit out the rest of a long wait after speeding up.
+    timer->interval = interval;
+    if(timer->wait > interval)
+    {
+      timer->wait = interval;
+    }
+  }
+}
+
+//Start a stopped axis with its first step one interval from now, so a move
+//handed over from another axis keeps its step spacing.
+//Call from an interupt or with interupts disabled.
+void startStepTimer(volatile StepTimer *timer, unsigned long interval)
+{
+  timer->interval = interval;
+  if(timer->pulses)
+  {
+    timer->wait = 0;
+    timer->timer->startPulses(interval, false);
+    return;
+  }
+  volatile uint16_t *compare = timer->timer->compareRegister(timer->channel);
+  timer->wait = interval;
+  *compare = timer->timer->read();
+  advanceCompare(timer);
+  timer->timer->enableCompare(timer->channel, *compare);
+}
+
+void stopStepTimer(volatile StepTimer *timer)
+{
+  if(timer->pulses)
+  {
+    timer->timer->stopPulses();
+  }
+  else
+  {
+    timer->timer->disableCompare(timer->channel);
+  }
+  timer->interval = 0;
+  timer->wait = 0;
+}
+
+//Called first thing in the compare interupt. Returns true if this match was
+//just a hop along a long interval and no step is due yet.
+int stepTimerHop(volatile StepTimer *timer)
+{
+  if(timer->wait == 0)
+  {
+    return false;
+  }
+  advanceCompare(timer);
+  return true;
+}
+
+//Called from the compare interupt after a step to set up the next one.
+//In pulse train mode the timer already runs on to the next pulse, only the
+//period needs loading. If the interupt was too late for that the old period
+//is kept and the new one goes in at the end of the next pulse.
+void scheduleStep(volatile StepTimer *timer)
+{
+  if(timer->pulses)
+  {
+    timer->timer->setPulsePeriod(timer->interval);
+    return;
+  }
+  timer->wait = timer->interval;
+  advanceCompare(timer);
+}
+
+//Keep a pulse train timer running but stop its pulses reaching the pin.
+//Steps timed on a shared timer are left out by the interupt instead.
+void muteStepTimer(volatile StepTimer *timer, int mute)
+{
+  if(timer->pulses)
+  {
+    timer->timer->mutePulses(mute);
+  }
+}
@@ -0,0 +1,62 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+#ifndef StepTimer_h
+#define StepTimer_h
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+#include "Timer16.h"
+
+//Fastest step rate any axis is driven at, in steps per second.
+#define MAX_STEP_RATE 20000L
+
+//Intervals longer than the 16 bit compare register are waited out in hops
+//of this many cycles.
+#define STEP_HOP 32768UL
+
+//A step is never scheduled closer than this many cycles to the current count,
+//so the compare can't be passed before the interupt returns.
+#define STEP_LEAD 64
+
+//Times the steps of one axis. There are two ways to do it:
+//On a compare channel of a free running timer, shared with other axes. Each
+//compare match is one step, the interupt raises the step pin and moves the
+//compare on to the next step.
+//On a timer of its own in pulse train mode. The timer makes the step pulses
+//on its output pin and the interupt at the end of each pulse only counts it
+//and loads the next period, so the step timing doesn't depend on the software.
+struct StepTimer {
+  long lastRate;//steps per second lastInterval was worked out for.
+  unsigned long lastInterval;
+  unsigned long interval;//timer cycles between steps, 0 when the axis is stopped.
+  unsigned long wait;//cycles still to wait after the current hop.
+  Timer16 *timer;
+  char channel;
+  char pulses;//true if the timer makes the pulses itself.
+};
+
+struct AxisTimers {
+  StepTimer x;
+  StepTimer y;
+  StepTimer z;
+};
+
+void attachStepTimer(volatile StepTimer *timer, Timer16 *hardware, char channel, void (*isr)());
+void attachPulseTimer(volatile StepTimer *timer, Timer16 *hardware, char channel, void (*isr)());
+unsigned long stepInterval(volatile StepTimer *timer, long rate);
+void setStepInterval(volatile StepTimer *timer, unsigned long interval);
+void startStepTimer(volatile StepTimer *timer, unsigned long interval);
+void stopStepTimer(volatile StepTimer *timer);
+int stepTimerHop(volatile StepTimer *timer);
+void scheduleStep(volatile StepTimer *timer);
+void muteStepTimer(volatile StepTimer *timer, int mute);
+
+#endif
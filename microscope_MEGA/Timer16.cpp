@@ -0,0 +1,230 @@
+/*
+ *  Interrupt and PWM utilities for the 16 bit timers on the ATmega1280/2560
+ *  Original code by Jesse Tane for http://labs.ideo.com August 2008
+ *  Modified March 2009 by Jérôme Despatis and Jesse Tane for ATmega328 support
+ *  Modified June 2009 by Michael Polli and Jesse Tane to fix a bug in setPeriod() which caused the timer to stop
+ *  Modified Oct 2009 by Dan Clemens to work with timer3 of the ATMega1280 or Arduino Mega
+ *  Modified 2012 for the microscope controller to drive any of Timer1, 3, 4 and 5
+ *
+ *  This is free software. You can redistribute it and/or modify it under
+ *  the terms of Creative Commons Attribution 3.0 United States License.
+ *  To view a copy of this license, visit http://creativecommons.org/licenses/by/3.0/us/
+ *  or send a letter to Creative Commons, 171 Second Street, Suite 300, San Francisco, California, 94105, USA.
+ *
+ */
+
+#include "Timer16.h"
+
+// preinstatiate, with the Arduino MEGA pins of the A, B and C outputs
+Timer16 Timer1(&TCCR1A, &TCCR1B, &TCNT1, &ICR1, &OCR1A, &OCR1B, &OCR1C, &TIMSK1, &TIFR1, 11, 12, 13);
+Timer16 Timer3(&TCCR3A, &TCCR3B, &TCNT3, &ICR3, &OCR3A, &OCR3B, &OCR3C, &TIMSK3, &TIFR3, 5, 2, 3);
+Timer16 Timer4(&TCCR4A, &TCCR4B, &TCNT4, &ICR4, &OCR4A, &OCR4B, &OCR4C, &TIMSK4, &TIFR4, 6, 7, 8);
+Timer16 Timer5(&TCCR5A, &TCCR5B, &TCNT5, &ICR5, &OCR5A, &OCR5B, &OCR5C, &TIMSK5, &TIFR5, 46, 45, 44);
+
+// interrupt service routines that wrap the user defined functions supplied by attachInterrupt
+// and attachCompareInterrupt
+#define TIMER16_ISRS(n) \
+ISR(TIMER##n##_OVF_vect)   { Timer##n.isrCallback(); } \
+ISR(TIMER##n##_COMPA_vect) { Timer##n.compareCallback[COMPARE_A](); } \
+ISR(TIMER##n##_COMPB_vect) { Timer##n.compareCallback[COMPARE_B](); } \
+ISR(TIMER##n##_COMPC_vect) { Timer##n.compareCallback[COMPARE_C](); }
+
+TIMER16_ISRS(1)
+TIMER16_ISRS(3)
+TIMER16_ISRS(4)
+TIMER16_ISRS(5)
+
+Timer16::Timer16(volatile uint8_t *tccrA, volatile uint8_t *tccrB, volatile uint16_t *tcnt, volatile uint16_t *icr,
+                 volatile uint16_t *ocrA, volatile uint16_t *ocrB, volatile uint16_t *ocrC,
+                 volatile uint8_t *timsk, volatile uint8_t *tifr, char pinA, char pinB, char pinC)
+{
+  _tccrA = tccrA;
+  _tccrB = tccrB;
+  _tcnt = tcnt;
+  _icr = icr;
+  _ocr[COMPARE_A] = ocrA;
+  _ocr[COMPARE_B] = ocrB;
+  _ocr[COMPARE_C] = ocrC;
+  _timsk = timsk;
+  _tifr = tifr;
+  _pins[COMPARE_A] = pinA;
+  _pins[COMPARE_B] = pinB;
+  _pins[COMPARE_C] = pinC;
+  _pulseChannel = COMPARE_A;
+  _muted = false;
+}
+
+void Timer16::initialize(long microseconds)
+{
+  *_tccrA = 0;                // clear control register A
+  *_tccrB = _BV(WGM13);       // set mode as phase and frequency correct pwm, stop the timer
+  setPeriod(microseconds);
+}
+
+void Timer16::setPeriod(long microseconds)
+{
+  long cycles = (F_CPU * microseconds) / 2000000;                                // the counter runs backwards after TOP, interrupt is at BOTTOM so divide microseconds by 2
+  if(cycles < RESOLUTION)              clockSelectBits = _BV(CS10);              // no prescale, full xtal
+  else if((cycles >>= 3) < RESOLUTION) clockSelectBits = _BV(CS11);              // prescale by /8
+  else if((cycles >>= 3) < RESOLUTION) clockSelectBits = _BV(CS11) | _BV(CS10);  // prescale by /64
+  else if((cycles >>= 2) < RESOLUTION) clockSelectBits = _BV(CS12);              // prescale by /256
+  else if((cycles >>= 2) < RESOLUTION) clockSelectBits = _BV(CS12) | _BV(CS10);  // prescale by /1024
+  else        cycles = RESOLUTION - 1, clockSelectBits = _BV(CS12) | _BV(CS10);  // request was out of bounds, set as maximum
+  *_icr = pwmPeriod = cycles;                                                    // ICRn is TOP in p & f correct pwm mode
+  *_tccrB &= ~(_BV(CS10) | _BV(CS11) | _BV(CS12));
+  *_tccrB |= clockSelectBits;                                                    // reset clock select register
+}
+
+char Timer16::channelOf(char pin)
+{
+  if(pin == _pins[COMPARE_B]) return COMPARE_B;
+  if(pin == _pins[COMPARE_C]) return COMPARE_C;
+  return COMPARE_A;
+}
+
+void Timer16::setPwmDuty(char pin, int duty)
+{
+  unsigned long dutyCycle = pwmPeriod;
+  dutyCycle *= duty;
+  dutyCycle >>= 10;
+  *_ocr[(int)channelOf(pin)] = dutyCycle;
+}
+
+void Timer16::pwm(char pin, int duty, long microseconds)  // expects duty cycle to be 10 bit (1024)
+{
+  if(microseconds > 0) setPeriod(microseconds);
+
+	// sets data direction register for pwm output pin
+	// activates the output pin
+  pinMode(pin, OUTPUT);
+  *_tccrA |= _BV(COM1A1 - 2 * channelOf(pin));
+  setPwmDuty(pin, duty);
+  start();
+}
+
+void Timer16::disablePwm(char pin)
+{
+  *_tccrA &= ~_BV(COM1A1 - 2 * channelOf(pin));           // clear the bit that enables pwm on the pin
+}
+
+void Timer16::attachInterrupt(void (*isr)(), long microseconds)
+{
+  if(microseconds > 0) setPeriod(microseconds);
+  isrCallback = isr;                                       // register the user's callback with the real ISR
+  *_timsk = _BV(TOIE1);                                    // sets the timer overflow interrupt enable bit
+  sei();                                                   // ensures that interrupts are globally enabled
+  start();
+}
+
+void Timer16::detachInterrupt()
+{
+  *_timsk &= ~_BV(TOIE1);                                  // clears the timer overflow interrupt enable bit
+}
+
+void Timer16::start()
+{
+  *_tccrB |= clockSelectBits;
+}
+
+void Timer16::stop()
+{
+  *_tccrB &= ~(_BV(CS10) | _BV(CS11) | _BV(CS12));         // clears all clock selects bits
+}
+
+void Timer16::restart()
+{
+  *_tcnt = 0;
+}
+
+void Timer16::initializeFreeRunning()
+{
+  *_tccrA = 0;                // normal mode, the compare channels don't touch the pins
+  *_tccrB = 0;                // stop the timer
+  *_timsk = 0;
+  *_tcnt = 0;
+  clockSelectBits = _BV(CS10);                             // no prescale, full xtal
+  pwmPeriod = RESOLUTION - 1;
+}
+
+void Timer16::attachCompareInterrupt(char channel, void (*isr)())
+{
+  compareCallback[(int)channel] = isr;
+}
+
+// call with interrupts disabled or from an interrupt
+void Timer16::enableCompare(char channel, unsigned int when)
+{
+  *_ocr[(int)channel] = when;
+  *_tifr = _BV(OCF1A + channel);                           // clear a stale match before enabling
+  *_timsk |= _BV(OCIE1A + channel);
+}
+
+void Timer16::disableCompare(char channel)
+{
+  *_timsk &= ~_BV(OCIE1A + channel);
+}
+
+void Timer16::initializePulses(char channel)
+{
+  *_tccrA = _BV(WGM11);                                    // fast pwm with TOP at ICRn, output off for now
+  *_tccrB = _BV(WGM13) | _BV(WGM12);                       // stop the timer
+  *_timsk = 0;
+  _pulseChannel = channel;
+  pinMode(_pins[(int)channel], OUTPUT);
+  digitalWrite(_pins[(int)channel], LOW);                  // the pin falls back to this when the output is off
+}
+
+// cycles from one pulse to the next, using the smallest prescale they fit.
+// ICRn isn't double buffered, so a TOP below the count would run the counter
+// all the way round. Call at the end of a pulse or while stopped; returns false
+// and leaves the period alone if the counter is already past the new TOP.
+bool Timer16::setPulsePeriod(unsigned long cycles)
+{
+  unsigned char shift;
+  if(cycles < RESOLUTION)               shift = 0, clockSelectBits = _BV(CS10);              // no prescale, full xtal
+  else if((cycles >> 3) < RESOLUTION)   shift = 3, clockSelectBits = _BV(CS11);              // prescale by /8
+  else if((cycles >> 6) < RESOLUTION)   shift = 6, clockSelectBits = _BV(CS11) | _BV(CS10);  // prescale by /64
+  else if((cycles >> 8) < RESOLUTION)   shift = 8, clockSelectBits = _BV(CS12);              // prescale by /256
+  else if((cycles >> 10) < RESOLUTION)  shift = 10, clockSelectBits = _BV(CS12) | _BV(CS10); // prescale by /1024
+  else   shift = 10, cycles = (RESOLUTION << 10) - 1, clockSelectBits = _BV(CS12) | _BV(CS10); // out of bounds, set as maximum
+
+  unsigned int top = (cycles >> shift) - 1;
+  unsigned int width = PULSE_WIDTH >> shift;
+  if(width == 0) width = 1;
+  if(isRunning() && *_tcnt >= top) return false;
+
+  *_icr = pwmPeriod = top;
+  *_ocr[(int)_pulseChannel] = width;                       // double buffered, takes effect at the next pulse
+  if(isRunning())
+  {
+    *_tccrB = (*_tccrB & ~(_BV(CS10) | _BV(CS11) | _BV(CS12))) | clockSelectBits;
+  }
+  return true;
+}
+
+// the first pulse starts on the next clock, or one period from now
+void Timer16::startPulses(unsigned long cycles, bool now)
+{
+  setPulsePeriod(cycles);
+  *_tcnt = now ? pwmPeriod : 0;                            // at TOP, the next count is BOTTOM which raises the pin
+  if(!_muted) *_tccrA |= _BV(COM1A1 - 2 * _pulseChannel);
+  *_tifr = _BV(OCF1A + _pulseChannel);
+  *_timsk |= _BV(OCIE1A + _pulseChannel);
+  start();
+}
+
+void Timer16::stopPulses()
+{
+  stop();
+  *_tccrA &= ~_BV(COM1A1 - 2 * _pulseChannel);             // the pin goes back to its port bit, which is low
+  *_timsk &= ~_BV(OCIE1A + _pulseChannel);
+}
+
+// keep the pulse timing and interrupts going but hold the pin low, or let the
+// pulses out again. Stays in effect across stops and starts.
+void Timer16::mutePulses(bool mute)
+{
+  _muted = mute;
+  if(mute) *_tccrA &= ~_BV(COM1A1 - 2 * _pulseChannel);
+  else if(isRunning()) *_tccrA |= _BV(COM1A1 - 2 * _pulseChannel);
+}
@@ -0,0 +1,104 @@
+/*
+ *  Interrupt and PWM utilities for the 16 bit timers on the ATmega1280/2560
+ *  Original code by Jesse Tane for http://labs.ideo.com August 2008
+ *  Modified March 2009 by Jérôme Despatis and Jesse Tane for ATmega328 support
+ *  Modified June 2009 by Michael Polli and Jesse Tane to fix a bug in setPeriod() which caused the timer to stop
+ *  Modified Oct 2009 by Dan Clemens to work with timer3 of the ATMega1280 or Arduino Mega
+ *  Modified 2012 for the microscope controller to drive any of Timer1, 3, 4 and 5
+ *
+ *  This is free software. You can redistribute it and/or modify it under
+ *  the terms of Creative Commons Attribution 3.0 United States License.
+ *  To view a copy of this license, visit http://creativecommons.org/licenses/by/3.0/us/
+ *  or send a letter to Creative Commons, 171 Second Street, Suite 300, San Francisco, California, 94105, USA.
+ *
+ */
+
+#ifndef Timer16_h
+#define Timer16_h
+
+#if ARDUINO>=100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <Wprogram.h> // Arduino 0022
+#endif
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define RESOLUTION 65536    // the timers are 16 bit
+
+// output compare channels
+#define COMPARE_A 0         // OCRnA
+#define COMPARE_B 1         // OCRnB
+#define COMPARE_C 2         // OCRnC
+
+// length of each pulse in pulse train mode, in clock cycles (2us)
+#define PULSE_WIDTH 32
+
+// All four 16 bit timers have the same registers and bits, so one class drives
+// any of them through pointers to its registers. The bit names below are the
+// Timer1 ones, the other timers use the same positions.
+class Timer16
+{
+  public:
+    Timer16(volatile uint8_t *tccrA, volatile uint8_t *tccrB, volatile uint16_t *tcnt, volatile uint16_t *icr,
+            volatile uint16_t *ocrA, volatile uint16_t *ocrB, volatile uint16_t *ocrC,
+            volatile uint8_t *timsk, volatile uint8_t *tifr, char pinA, char pinB, char pinC);
+
+    // properties
+    unsigned int pwmPeriod;
+    unsigned char clockSelectBits;
+
+    // methods
+    void initialize(long microseconds=1000000);
+    void start();
+    void stop();
+    void restart();
+    void pwm(char pin, int duty, long microseconds=-1);
+    void disablePwm(char pin);
+    void attachInterrupt(void (*isr)(), long microseconds=-1);
+    void detachInterrupt();
+    void setPeriod(long microseconds);
+    void setPwmDuty(char pin, int duty);
+    void (*isrCallback)();
+
+    // free running mode: the counter wraps at RESOLUTION with no prescale and
+    // each compare channel raises its own interrupt when the counter passes it
+    void initializeFreeRunning();
+    void attachCompareInterrupt(char channel, void (*isr)());
+    void enableCompare(char channel, unsigned int when);
+    void disableCompare(char channel);
+    volatile uint16_t *compareRegister(char channel) { return _ocr[(int)channel]; }
+    unsigned int read() { return *_tcnt; }
+    void write(unsigned int count) { *_tcnt = count; }
+    bool isRunning() { return (*_tccrB & (_BV(CS10) | _BV(CS11) | _BV(CS12))) != 0; }
+    void (*compareCallback[3])();
+
+    // pulse train mode: fast pwm with ICRn as TOP. The channel's pin goes high
+    // at the start of every period and low PULSE_WIDTH cycles later, so the
+    // pulses need no software. The compare interrupt fires at the end of each one.
+    void initializePulses(char channel);
+    void startPulses(unsigned long cycles, bool now=true);
+    bool setPulsePeriod(unsigned long cycles);
+    void stopPulses();
+    void mutePulses(bool mute);
+
+  private:
+    char channelOf(char pin);
+    volatile uint8_t *_tccrA;
+    volatile uint8_t *_tccrB;
+    volatile uint16_t *_tcnt;
+    volatile uint16_t *_icr;
+    volatile uint16_t *_ocr[3];
+    volatile uint8_t *_timsk;
+    volatile uint8_t *_tifr;
+    char _pins[3];
+    char _pulseChannel;
+    bool _muted;
+};
+
+extern Timer16 Timer1;
+extern Timer16 Timer3;
+extern Timer16 Timer4;
+extern Timer16 Timer5;
+
+#endif
@@ -9,23 +9,56 @@
 //Libraries//
 /////////////
 
-// The TimerThree library is required.
-// Get it from http://www.arduino.cc/playground/Code/Timer1
-// Unpack the files someplace then add TimerThree.cpp and TimerThree.h from the 
-// Sketch->"Add File" menu.
-#include "TimerThree.h"
+// Timer16 drives the MEGA's 16 bit timers. It grew out of the TimerThree library
+// from http://www.arduino.cc/playground/Code/Timer1
+#include "Timer16.h"
+
+//StepTimer times the steps of each axis on the 16 bit timers.
+#include "StepTimer.h"
 
 //AsiMS2000 encapsulates the interface to the MicroManager.
-//AsiMS2000 defaults to PC communinication on Serial1 at 9600
+//AsiMS2000 defaults to PC communinication on Serial1 at 9600, or the rate
+//last set with BAUD,
 //with debug output on Serial at 115200.
 #include "AsiMS2000.h"
 AsiMS2000 AsiMS2000;
 
+//MotionProfile holds the speed ramps used for moves from the PC.
+#include "MotionProfile.h"
+
+//MoveQueue holds moves from the PC until they run and plans the speed
+//they go round each corner at.
+#include "MoveQueue.h"
+
+//SegmentBuffer cuts the queued moves into short runs of steps at one speed
+//for the step interupt.
+#include "SegmentBuffer.h"
+
+//PinMap turns pin numbers into port registers so the interupt
+//can drive the step and direction pins without digitalWrite.
+#include "PinMap.h"
+
+//JoystickAdc reads the joysticks in the background from the ADC interupt.
+#include "JoystickAdc.h"
+
+//JoystickCurve turns joystick inputs into speeds with a table.
+#include "JoystickCurve.h"
+
 /////////////////////////
 //Serial Debug Messages//
 /////////////////////////
 #define DEBUG true
 
+//////////////////////
+//Step pulse source//
+//////////////////////
+//false: Timer3 free runs and steps are timed on its three compare channels,
+//the interupt sets and clears the step pins.
+//true: each axis gets a timer of its own that makes the step pulses in hardware,
+//X on Timer1, Y on Timer3 and Z on Timer4, with the speed ramps on Timer5.
+//The step pins must then be the timer outputs, which moves X step to pin 11.
+#define HARDWARE_STEPS false
+
 ///////////////////
 //Pin assignments//
 ///////////////////
@@ -33,11 +66,11 @@ AsiMS2000 AsiMS2000;
 
 //Motors are driven by the EasyDriver board: http://www.sparkfun.com/products/10267
 const int motorX_dir  = 2;
-const int motorX_step = 3;
+const int motorX_step = HARDWARE_STEPS ? 11 : 3;//OC1A in hardware mode.
 const int motorY_dir  = 4;
-const int motorY_step = 5;
+const int motorY_step = 5;//OC3A
 const int motorZ_dir  = 6;
-const int motorZ_step = 7;
+const int motorZ_step = 7;//OC4B
 
 const int gnd_resetSteppers = 8;//ground to reset
 const int disableSteppers = 9; //Enable on the A3967SLB is "Active Low", so the name is changed to make programming clearers.
@@ -48,9 +81,18 @@ const int motorX_input = A0;
 const int motorY_input = A1;
 const int motorZ_input = A2;
 
-const int motorX_lockout = 22;
-const int motorY_lockout = 24;
-const int motorZ_lockout = 26;
+//TTL trigger input, from a camera for example. Pin 21 is INT0, which
+//attachInterrupt() numbers 2 on the MEGA.
+const int ttl_input = 21;
+const int ttl_interrupt = 2;
+//TTL output, pulsed with the step that starts a SCAN and each of its lines.
+const int ttl_output = 20;
+
+//Lockout switches, pulled low when closed. They are on port K, A8 to A10,
+//where a change on any of them raises the PCINT2 interupt.
+const int motorX_lockout = A8;
+const int motorY_lockout = A9;
+const int motorZ_lockout = A10;
 
 /////////////////////////
 //programming constants//
@@ -62,21 +104,105 @@ const int pot_center = 512;
 /////////////////////////////////////////
 //Timing Constants and shared variables//
 /////////////////////////////////////////
-const int32_t intPerSec = 1500;//number of interupts proccessed per second. Also the max number of 1/8th motor steps per second.
-const int input_delay = 500; //delay between reading inputs in microseconds.
-long perSecRatio = 0;//set in setup routine based on interupts per sec.
+//The ramp timer free runs at the full clock and its overflow interupt sets the
+//joystick speeds. Each axis gets an interupt when a step is due or, with
+//HARDWARE_STEPS, when its timer has finished a pulse.
+//Moves from the PC are cut into segments of one ramp tick each in the foreground.
+Timer16 *rampTimer = HARDWARE_STEPS ? &Timer5 : &Timer3;
+const long rampTicksPerSec = F_CPU / RESOLUTION;//about 244 ramp updates per second.
+const long jogStepRate = 1500;//top speed from the joysticks, in 1/8th motor steps per second.
+const long joystick_period = 4000; //time between joystick updates in microseconds, 250 a second.
+const int debug_delay = 1000; //delay between debug messages in milliseconds.
+
+//The joystick inputs are smoothed before they set a speed. Each update moves
+//the filtered input a quarter of the way to the new reading, which settles in
+//about 15ms. They are kept JOYSTICK_FILTER_SCALE bits finer than the readings.
+#define JOYSTICK_FILTER_SHIFT 2
+#define JOYSTICK_FILTER_SCALE 4
+AxisSettings joystickFiltered;
+AxisSettings joystickSpeed;//signed speed last set from the joysticks, in steps per second.
 
 //Variables to pass motor timing information into interupt routine.
-const float moveTolerance = 0.000599;//define how close the position has to be in tenths of micrometers.
 volatile AxisSettings axisSpeed;
-volatile int interupts = 0;
+volatile AxisTimers stepTimer;
 volatile AxisSettings actualPosition;
+volatile uint8_t positionVersion = 0;//moved on each time actualPosition is written.
 volatile AxisSettings axisDirection;
 
+//Lockout switches as the pin change interupt last read them, and faults
+//latched when one closed on an axis that wasn't homing. RDSTAT reports both.
+//An axis with its switch closed is frozen against moving any further
+//toward it, the step interupts leave its steps out.
+volatile AxisSettings lockedOut;
+volatile AxisSettings lockoutFault;
+volatile uint8_t frozenAxes = 0;//AXIS_MASK bits.
+volatile uint8_t lockoutTrips = 0;//counted by the interupt, handled in loop().
+#define AXIS_MASK(axis) (1 << (axis))
+
+//Segment and line the step interupt is working through.
+volatile MoveSegment moveSegment;
+volatile LineMove moveLine;
+volatile int moveInProgress = false;
+volatile int moveComplete = false;
+
+//Where the stage will be once every queued move has run.
+AxisSettings queuedPosition;
+
+//A MOVE or MOVREL queues up to two lines, the second for the anti-backlash approach.
+const int movesPerCommand = 2;
+
+//Rising edges on the TTL input, counted by its interupt and handled in loop().
+volatile uint8_t ttlPulses = 0;
+
+//Raster scan started by SCAN, queued a line at a time from loop().
+//Positions are in steps.
+const int scanMovesPerLine = 4;
+int scanning = false;
+int scanPattern;
+long scanLine;//next line to queue.
+long scanLines;
+long scanStart;//fast axis range.
+long scanStop;
+long scanSlowStart;//slow axis position of the first and last lines.
+long scanSlowStop;
+long scanRunUp;//fast axis steps to get up to speed before the range, and to stop after it.
+
+//Homing started by HOME. Each axis runs on its own step timer, as it does
+//from the joysticks, so each one stops on its own switch. The lockout pins
+//are the home switches, pulled low when closed, and lie in the negative direction.
+#define HOME_IDLE 0
+#define HOME_SEEK 1//fast toward the switch.
+#define HOME_BACK_OFF 2//slowly away until the switch opens.
+#define HOME_CLEAR 3//on past that by homeBackOff steps.
+#define HOME_LOCATE 4//slowly back until the switch closes, which sets the position.
+#define HOME_RELEASE 5//slowly away again to homeTarget.
+#define HOME_FOUND 6
+const long homeSlowRate = 1000;//steps per second off and back onto the switch.
+const long homeBackOff = 500;//more than the switches' hysteresis.
+AxisSettings homeAxes;//axes HOME asked for.
+volatile AxisSettings homePhase;
+AxisSettings homeTarget;//home position of each axis, from SETHOME.
+AxisSettings homeClearance;//steps from the switch to homeTarget.
+AxisSettings homeSeekRate;
+AxisSettings homeClearFrom;//where each switch opened.
+AxisSettings homeRunFrom;//where each axis started onto or off its switch.
+AxisSettings homeMaxTravel;//steps each axis can go in stageTravel.
+int homing = false;
+int homeStarted = false;//false while the moves from before HOME finish.
+unsigned long homeStartTime;
+int homeMovePending = false;//a MOVE or SCAN came in while homing.
+int homeScanPending = false;
+
+//Set by HALT until the stage has stopped. Where the stage ends up isn't known
+//till then, so commands wait.
+int halting = false;
+
+//The ramp down after a HALT, run by the ramp interupt. Once it has started the
+//step interupt takes no more segments and carries on along its line until
+//the ramp is over.
+volatile int haltRamping = false;
+volatile StopRamp haltRamp;
 
-//The actual position stored as INT divided by this factor will give
-//The position in tenths of microns.
-const int stepConversion = 1000;
 
 
 void setup() 
@@ -94,14 +220,13 @@ void setup()
   pinMode(motorX_step, OUTPUT);
   pinMode(motorY_step, OUTPUT);
   pinMode(motorZ_step, OUTPUT);
-  pinMode(motorX_step, OUTPUT);
   pinMode(motorX_dir, OUTPUT);
   pinMode(motorY_dir, OUTPUT);
   pinMode(motorZ_dir, OUTPUT);
   
   digitalWrite(motorX_step, LOW);
-  digitalWrite(motorX_step, LOW);
-  digitalWrite(motorX_step, LOW);
+  digitalWrite(motorY_step, LOW);
+  digitalWrite(motorZ_step, LOW);
   digitalWrite(motorX_dir, LOW);
   digitalWrite(motorY_dir, LOW);
   digitalWrite(motorZ_dir, LOW);
@@ -109,10 +234,16 @@ void setup()
   pinMode(motorX_input, INPUT);
   pinMode(motorY_input, INPUT);
   pinMode(motorZ_input, INPUT);
+  startJoystickAdc(motorX_input, motorY_input, motorZ_input);
+  updateJoystickRates();
+  AsiMS2000.attachJoystickCallback(updateJoystickRates);
  
   pinMode(motorX_lockout, INPUT);
   pinMode(motorY_lockout, INPUT);
   pinMode(motorZ_lockout, INPUT);
+  pinMode(ttl_input, INPUT);
+  pinMode(ttl_output, OUTPUT);
+  digitalWrite(ttl_output, LOW);
  
   //enable output and reset the boards.
   digitalWrite(disableSteppers, LOW);
@@ -120,19 +251,53 @@ void setup()
   delayMicroseconds(1);
   digitalWrite(gnd_resetSteppers, HIGH);
   
-  //initialize the actual position.
-  //TODO: create a homing routine to run to the negative limits.
-  actualPosition.x = 0;
-  actualPosition.y = 0;
-  actualPosition.z = 0;
+  //initialize the actual position to the power on position, so the stage
+  //stays where it is until the PC moves it. HOME finds the real position
+  //from the home switches.
+  AxisSettings powerOn = AsiMS2000.getDesiredSteps();
+  actualPosition.x = powerOn.x;
+  actualPosition.y = powerOn.y;
+  actualPosition.z = powerOn.z;
   
-  //setup the interupt routine.
-  perSecRatio = ((512L * 512L) / intPerSec)+1;//+1 to make up for not doing floating point calculations.
-  int32_t timerFactor = 1000000 / intPerSec;  
-  Timer3.initialize(timerFactor);
-  Timer3.attachInterrupt(motorCallback);
+  //setup the interupt routines. The timer only runs while an axis is moving.
+  rampTimer->initializeFreeRunning();
+  if(HARDWARE_STEPS)
+  {
+    attachPulseTimer(&stepTimer.x, &Timer1, COMPARE_A, stepCallbackX);
+    attachPulseTimer(&stepTimer.y, &Timer3, COMPARE_A, stepCallbackY);
+    attachPulseTimer(&stepTimer.z, &Timer4, COMPARE_B, stepCallbackZ);
+  }
+  else
+  {
+    attachStepTimer(&stepTimer.x, &Timer3, COMPARE_A, stepCallbackX);
+    attachStepTimer(&stepTimer.y, &Timer3, COMPARE_B, stepCallbackY);
+    attachStepTimer(&stepTimer.z, &Timer3, COMPARE_C, stepCallbackZ);
+  }
+  rampTimer->attachInterrupt(rampCallback);
+  rampTimer->stop();
+  
+  //moves from the PC are queued as soon as the command arrives.
+  //The position is only read back in steps when the PC asks for it.
+  AsiMS2000.attachPositionSource(&actualPosition, &positionVersion);
+  AsiMS2000.attachMoveCallback(startMove);
+  AsiMS2000.attachScanCallback(startScan);
+  AsiMS2000.attachHaltCallback(haltMove);
+  AsiMS2000.attachHomeCallback(startHoming);
+  attachInterrupt(ttl_interrupt, ttlCallback, RISING);
+  
+  //watch the lockout switches. Closed at power on is not a fault.
+  noInterrupts();
+  readLockoutSwitches(false);
+  interrupts();
+  AsiMS2000.attachLockoutSource(&lockedOut, &lockoutFault);
+  PCMSK2 = PIN_MASK(motorX_lockout) | PIN_MASK(motorY_lockout) | PIN_MASK(motorZ_lockout);
+  PCIFR = _BV(PCIF2);
+  PCICR |= _BV(PCIE2);
   
+  AsiMS2000.begin();
   Serial.begin(115200);
+  //there is nothing to move to at power on.
+  AsiMS2000.clearBusyStatus();
   Serial.println("Startup Complete.");
 }
 
@@ -141,24 +306,80 @@ void loop()
 {
   static unsigned long lastInputTime = 0;
   static unsigned long lastOutputTime = 0;
+  static uint8_t ttlPulsesHandled = 0;
+  static uint8_t lockoutTripsHandled = 0;
   unsigned long time = 0;
 
   //call the serial protocol to check for incoming commands from the PC.
-  AsiMS2000.checkSerial();
+  //While the move queue is full, or a HALT is stopping the stage, the commands
+  //wait, but a HALT behind them is still acted on straight away.
+  AsiMS2000.checkHalt();
+  if(moveQueueSpace() >= movesPerCommand && !halting)
+  {
+    AsiMS2000.checkSerial();
+  }
+  
+  //the axis that hit its lockout is already frozen, bring the rest of the
+  //move to a stop. Its targets can't be reached any more.
+  if(lockoutTrips != lockoutTripsHandled)
+  {
+    lockoutTripsHandled = lockoutTrips;
+    if(DEBUG){Serial.println("Lockout.");}
+    if(moveInProgress || moveSegmentsPending() || scanning)
+    {
+      haltMove();
+    }
+  }
+  
+  //one TTL pulse at a time, each may queue a move.
+  if(ttlPulses != ttlPulsesHandled && moveQueueSpace() >= movesPerCommand && !halting)
+  {
+    ttlPulsesHandled++;
+    AsiMS2000.ttlPulse();
+  }
+  
+  //keep the step interupt supplied with segments.
+  continueHoming();
+  continueScan();
+  prepareSegments(rampTicksPerSec);
+  startSegments();
+  
+  //the interupt flags when it runs out of segments, report it from here rather
+  //than the interupt. Busy stays set while more of the moves are waiting.
+  if(moveComplete)
+  {
+    moveComplete = false;
+    if(!moveInProgress && !moveSegmentsPending() && !scanning && !homing)
+    {
+      if(halting)
+      {
+        halting = false;
+        haltRamping = false;
+        AsiMS2000.setDesiredSteps(AsiMS2000.getCurrentPos());
+      }
+      AsiMS2000.clearBusyStatus();
+    }
+  }
 
    
-  time = millis();
-  //handle direct input only if not already busy handling moves from the PC.
-  if(time - lastInputTime > input_delay && AsiMS2000.getBusyStatus() == false)
+  //the joysticks are read on a steady beat so the filter and the speed
+  //limit work out the same however busy the loop is.
+  time = micros();
+  if(time - lastInputTime >= joystick_period)
   {
     realTimeHandler(time);
-    lastInputTime = time;     
+    lastInputTime += joystick_period;
+    if(time - lastInputTime >= joystick_period)
+    {
+      lastInputTime = time;//fallen behind, don't try to catch up.
+    }
   }
   
-  //rollover the interupt timer for the timer callback routine.
-  if(interupts >= intPerSec)
+  time = millis();
+  
+  if(time - lastOutputTime >= debug_delay)
   {
-    interupts = 0;
+    lastOutputTime = time;
     displayDebugInfo();    
   }
 }
@@ -189,52 +410,50 @@ void displayDebugInfo()
     Serial.println(buffer);
 }
 
-//convert from int position to float postion
-//actual position is maintained as LONG for accuracy.
-AxisSettingsF actualPositionToF()
-{
-  AxisSettingsF floatPosition;
-  floatPosition.x = (float)actualPosition.x / (float)stepConversion;
-  floatPosition.y = (float)actualPosition.y / (float)stepConversion;
-  floatPosition.z = (float)actualPosition.z / (float)stepConversion;
-  return floatPosition;
-}
-
-int isWithinTolerance(float one, float two, float tolerance)
-{
-  if(one > two + tolerance || one < two - tolerance)
-  {
-    return false;
-  } 
-  return true;
-}
-
 //Check inputs and set motor speeds appropriatly.
+//The inputs are filtered all the time, but only drive the motors when
+//there are no moves from the PC.
 void realTimeHandler(unsigned long time)
 {
     AxisSettings inputArray;
     AxisSettings lockoutArray;  
     readInputs(&inputArray);
-    readLockouts(&lockoutArray);
     adjustInput(&inputArray);
-    setMotorDirection(&inputArray);
+    filterInputs(&inputArray);
+    if(AsiMS2000.getBusyStatus())
+    {
+      //the moves own the motors. Start again from standing once they finish.
+      joystickSpeed.x = 0;
+      joystickSpeed.y = 0;
+      joystickSpeed.z = 0;
+      return;
+    }
+    readLockouts(&lockoutArray);
     calculateMotorSpeeds(&inputArray);
+    limitSpeedChange(&inputArray);
+    setMotorDirection(&inputArray);
     setMotorSpeeds(&inputArray, &lockoutArray);
+    if(inputArray.x != 0 || inputArray.y != 0 || inputArray.z != 0)
+    {
+      wakeStepTimer();
+    }
 }
 
 
+//The ADC interupt keeps the readings up to date, so this doesn't wait.
 void readInputs(AxisSettings *inputs)
 {
-  inputs->x = analogRead(motorX_input);
-  inputs->y = analogRead(motorY_input);
-  inputs->z = analogRead(motorZ_input); 
+  readJoystickAdc(inputs);
 }
 
+//Lockout switches that are closed, as the pin change interupt last read them.
 void readLockouts(AxisSettings *lockouts)
 {
-  lockouts->x = digitalRead(motorX_lockout);
-  lockouts->y = digitalRead(motorY_lockout);
-  lockouts->z = digitalRead(motorZ_lockout); 
+  noInterrupts();
+  lockouts->x = lockedOut.x;
+  lockouts->y = lockedOut.y;
+  lockouts->z = lockedOut.z;
+  interrupts();
 }
 
 void adjustInput(AxisSettings *inputs)
@@ -244,176 +463,1017 @@ void adjustInput(AxisSettings *inputs)
    inputs->z = inputs->z - pot_center;
 }
 
+//Low pass filter the centered inputs, so the noise on the pots doesn't
+//come through as jitter in the speed.
+void filterInputs(AxisSettings *inputs)
+{
+  joystickFiltered.x += ((inputs->x << JOYSTICK_FILTER_SCALE) - joystickFiltered.x) >> JOYSTICK_FILTER_SHIFT;
+  joystickFiltered.y += ((inputs->y << JOYSTICK_FILTER_SCALE) - joystickFiltered.y) >> JOYSTICK_FILTER_SHIFT;
+  joystickFiltered.z += ((inputs->z << JOYSTICK_FILTER_SCALE) - joystickFiltered.z) >> JOYSTICK_FILTER_SHIFT;
+  inputs->x = joystickFiltered.x >> JOYSTICK_FILTER_SCALE;
+  inputs->y = joystickFiltered.y >> JOYSTICK_FILTER_SCALE;
+  inputs->z = joystickFiltered.z >> JOYSTICK_FILTER_SCALE;
+}
+
+//Move the joystick speeds toward the signed speeds asked for no faster than
+//the ACCEL of each axis allows, going through a stop to change direction.
+void limitSpeedChange(AxisSettings *speeds)
+{
+  AxisSettings accelTime = AsiMS2000.getAccel();
+  joystickSpeed.x = slewSpeed(joystickSpeed.x, speeds->x, accelTime.x);
+  joystickSpeed.y = slewSpeed(joystickSpeed.y, speeds->y, accelTime.y);
+  joystickSpeed.z = slewSpeed(joystickSpeed.z, speeds->z, accelTime.z);
+  *speeds = joystickSpeed;
+}
+
+//One update of a speed limited to the change from standing to the top
+//joystick speed over accelTime ms.
+long slewSpeed(long speed, long target, long accelTime)
+{
+  if(accelTime <= 0)
+  {
+    return target;
+  }
+  long step = max(jogStepRate * joystick_period / (accelTime * 1000L), 1L);
+  return constrain(target, speed - step, speed + step);
+}
+
 void setMotorDirection(AxisSettings *inputs)
 {
-   axisDirection.x = setDir(inputs->x, motorX_dir);
-   axisDirection.y = setDir(inputs->y, motorY_dir);
-   axisDirection.z = setDir(inputs->z, motorZ_dir);
+   axisDirection.x = setDir(inputs->x, PIN_PORT(motorX_dir), PIN_MASK(motorX_dir));
+   axisDirection.y = setDir(inputs->y, PIN_PORT(motorY_dir), PIN_MASK(motorY_dir));
+   axisDirection.z = setDir(inputs->z, PIN_PORT(motorZ_dir), PIN_MASK(motorZ_dir));
+   noInterrupts();
+   applyLockouts();
+   interrupts();
 }
 
+//A closed lockout only stops an axis moving toward its switch, the same as
+//applyLockouts(), so the joystick can still drive it back off.
 void setMotorSpeeds(AxisSettings *inputs, AxisSettings *lockouts)
 {
-  if(lockouts->x == 1) 
+  if(lockouts->x && !axisDirection.x) 
   { 
-    axisSpeed.x = inputs->x; 
+    axisSpeed.x = 0; 
+    joystickSpeed.x = 0;
   }
   else
   {
-     axisSpeed.x = 0; 
+    axisSpeed.x = labs(inputs->x); 
   }
   
-  if(lockouts->y == 1) 
+  if(lockouts->y && !axisDirection.y) 
   { 
-    axisSpeed.y = inputs->y; 
+    axisSpeed.y = 0; 
+    joystickSpeed.y = 0;
   }
   else
   {
-     axisSpeed.y = 0; 
+    axisSpeed.y = labs(inputs->y); 
   }
   
-  if(lockouts->z == 1) 
+  if(lockouts->z && !axisDirection.z) 
   { 
-    axisSpeed.z = inputs->z; 
+    axisSpeed.z = 0; 
+    joystickSpeed.z = 0;
   }
   else
   {
-     axisSpeed.z = 0; 
+    axisSpeed.z = labs(inputs->z); 
   }
 }
 
 //set the direction to the pin and returns the value set.
-int setDir(float pos, int pin)
+//The step pins share ports with the direction pins and are written from the
+//interupt, so interupts are held off for the read-modify-write.
+int setDir(long pos, volatile uint8_t *port, uint8_t mask)
 {
+   uint8_t oldSREG = SREG;
+   cli();
    if(pos > 0)
    {
-     digitalWrite(pin, HIGH);
+     *port |= mask;
+     SREG = oldSREG;
      return true;
    }
    else
    {
-     digitalWrite(pin, LOW);
+     *port &= ~mask;
+     SREG = oldSREG;
      return false;
    }
 }
 
 //Take the input values (after center adjustment)
-//and calculate the pulses per second to send to the motor.
+//and look up the signed pulses per second to send to the motor.
 void calculateMotorSpeeds(AxisSettings *inputs)
 {
-  //square the input to get a good input curve
-  if(abs(inputs->x) > dead_zone)
+  inputs->x = joystickRate(inputs->x);
+  inputs->y = joystickRate(inputs->y);
+  inputs->z = joystickRate(inputs->z);
+}
+
+//Called by AsiMS2000 when JSSPD or JSCURVE change the joystick response.
+void updateJoystickRates()
+{
+  AxisSettings percent = AsiMS2000.getJoystickSpeed();
+  AxisSettings curve = AsiMS2000.getJoystickCurve();
+  buildJoystickRates(curve.x, curve.y, curve.z, dead_zone,
+                     jogStepRate * percent.y / 100, jogStepRate * percent.x / 100);
+}
+
+//Called automatically by the ramp timer overflow, rampTicksPerSec times a second
+//while the timer runs. Hands the joystick speeds to the step timers and stops
+//the timer once nothing is left to move. Moves from the PC are left to the
+//step interupts.
+void rampCallback()
+{
+    //a HALT is watched for here as well as in loop(), so the stage starts to
+    //stop within a tick of the \ arriving however long loop() is busy.
+    if(moveInProgress)
+    {
+      if(AsiMS2000.receiveSerial())
+      {
+        startHaltRamp();
+      }
+      if(haltRamping)
+      {
+        runHaltRamp();
+      }
+      return;
+    }
+    
+    //Turning speeds into intervals takes long divisions. Let the step
+    //interupts in meanwhile so a pulse is never counted late.
+    sei();
+    unsigned long xInterval = stepInterval(&stepTimer.x, axisSpeed.x);
+    unsigned long yInterval = stepInterval(&stepTimer.y, axisSpeed.y);
+    unsigned long zInterval = stepInterval(&stepTimer.z, axisSpeed.z);
+    cli();
+    
+    setStepInterval(&stepTimer.x, xInterval);
+    setStepInterval(&stepTimer.y, yInterval);
+    setStepInterval(&stepTimer.z, zInterval);
+    
+    if(stepTimer.x.interval == 0 && 
+       stepTimer.y.interval == 0 && 
+       stepTimer.z.interval == 0)
+    {
+      rampTimer->stop();
+    }
+}
+
+//Runs the moment a lockout pin changes.
+ISR(PCINT2_vect)
+{
+  readLockoutSwitches(true);
+}
+
+//Read the lockout switches. With latch set a switch that has just closed on
+//an axis that isn't homing latches a fault for loop() to act on.
+//Call from an interupt or with interupts disabled.
+void readLockoutSwitches(int latch)
+{
+  long x = !(*PIN_INPUT(motorX_lockout) & PIN_MASK(motorX_lockout));
+  long y = !(*PIN_INPUT(motorY_lockout) & PIN_MASK(motorY_lockout));
+  long z = !(*PIN_INPUT(motorZ_lockout) & PIN_MASK(motorZ_lockout));
+  if(latch && ((x && !lockedOut.x && homePhase.x == HOME_IDLE) ||
+               (y && !lockedOut.y && homePhase.y == HOME_IDLE) ||
+               (z && !lockedOut.z && homePhase.z == HOME_IDLE)))
+  {
+    if(x && homePhase.x == HOME_IDLE){lockoutFault.x = true;}
+    if(y && homePhase.y == HOME_IDLE){lockoutFault.y = true;}
+    if(z && homePhase.z == HOME_IDLE){lockoutFault.z = true;}
+    lockoutTrips++;
+  }
+  lockedOut.x = x;
+  lockedOut.y = y;
+  lockedOut.z = z;
+  applyLockouts();
+}
+
+//Work out which axes their lockouts freeze, those with the switch closed that
+//are set to move toward it. Homing runs onto the switches on purpose.
+//With HARDWARE_STEPS the timers make the pulses themselves, so the pins of
+//frozen axes are muted as well.
+//Call after the switches or the directions change, from an interupt or with
+//interupts disabled.
+void applyLockouts()
+{
+  uint8_t frozen = 0;
+  if(lockedOut.x && !axisDirection.x && homePhase.x == HOME_IDLE){frozen |= AXIS_MASK(AXIS_X);}
+  if(lockedOut.y && !axisDirection.y && homePhase.y == HOME_IDLE){frozen |= AXIS_MASK(AXIS_Y);}
+  if(lockedOut.z && !axisDirection.z && homePhase.z == HOME_IDLE){frozen |= AXIS_MASK(AXIS_Z);}
+  frozenAxes = frozen;
+  if(HARDWARE_STEPS)
+  {
+    muteStepTimer(&stepTimer.x, frozen & AXIS_MASK(AXIS_X));
+    muteStepTimer(&stepTimer.y, frozen & AXIS_MASK(AXIS_Y));
+    muteStepTimer(&stepTimer.z, frozen & AXIS_MASK(AXIS_Z));
+  }
+}
+
+//Called on each rising edge of the TTL input.
+void ttlCallback()
+{
+  ttlPulses++;
+}
+
+//Start the ramp timer if it is asleep. The count is put just short of the
+//overflow so the first ramp update, and with it the first step, comes straight away.
+void wakeStepTimer()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  if(!rampTimer->isRunning())
+  {
+    rampTimer->write(RESOLUTION - STEP_LEAD);
+    rampTimer->start();
+  }
+  SREG = oldSREG;
+}
+
+//The step interupts, one per axis. In software each runs at the moment a step
+//is due. The step pin is raised first so the edge is on time and lowered once
+//the step is counted, which holds it high for well over the 1us the drivers need.
+//With HARDWARE_STEPS the timer has already made the pulse and it is only counted.
+//During a move only the lead axis timer runs and it steps the whole line.
+void stepCallbackX()
+{
+  if(stepTimerHop(&stepTimer.x)){return;}
+  if(moveInProgress){lineStep(&stepTimer.x); return;}
+  if(frozenAxes & AXIS_MASK(AXIS_X)){scheduleStep(&stepTimer.x); return;}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorX_step) |= PIN_MASK(motorX_step);}
+  countStep(&stepTimer.x, &actualPosition.x, axisDirection.x);
+  if(homePhase.x != HOME_IDLE){homeStep(AXIS_X);}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorX_step) &= ~PIN_MASK(motorX_step);}
+}
+
+void stepCallbackY()
+{
+  if(stepTimerHop(&stepTimer.y)){return;}
+  if(moveInProgress){lineStep(&stepTimer.y); return;}
+  if(frozenAxes & AXIS_MASK(AXIS_Y)){scheduleStep(&stepTimer.y); return;}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorY_step) |= PIN_MASK(motorY_step);}
+  countStep(&stepTimer.y, &actualPosition.y, axisDirection.y);
+  if(homePhase.y != HOME_IDLE){homeStep(AXIS_Y);}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorY_step) &= ~PIN_MASK(motorY_step);}
+}
+
+void stepCallbackZ()
+{
+  if(stepTimerHop(&stepTimer.z)){return;}
+  if(moveInProgress){lineStep(&stepTimer.z); return;}
+  if(frozenAxes & AXIS_MASK(AXIS_Z)){scheduleStep(&stepTimer.z); return;}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorZ_step) |= PIN_MASK(motorZ_step);}
+  countStep(&stepTimer.z, &actualPosition.z, axisDirection.z);
+  if(homePhase.z != HOME_IDLE){homeStep(AXIS_Z);}
+  if(!HARDWARE_STEPS){*PIN_PORT(motorZ_step) &= ~PIN_MASK(motorZ_step);}
+}
+
+//While homing, an axis stops on the step that closes its switch, so the
+//switch is found to the step. On the slow approach that step sets the
+//position, homeClearance short of the home position, and the axis then
+//stops on the step that reaches it. Finishing clear of the switch means
+//moves back to home don't close it again and trip a lockout.
+void homeStep(int axis)
+{
+  volatile long *phase = axisValue(&homePhase, axis);
+  if(*phase == HOME_RELEASE)
+  {
+    if(*axisValue(&actualPosition, axis) >= *axisValue(&homeTarget, axis))
+    {
+      stopStepTimer(axisStepTimer(axis));
+      *axisValue(&axisSpeed, axis) = 0;
+      *phase = HOME_FOUND;
+    }
+    return;
+  }
+  if((*phase != HOME_SEEK && *phase != HOME_LOCATE) || !homeSwitchClosed(axis))
+  {
+    return;
+  }
+  stopStepTimer(axisStepTimer(axis));
+  *axisValue(&axisSpeed, axis) = 0;
+  if(*phase == HOME_LOCATE)
+  {
+    *axisValue(&actualPosition, axis) = *axisValue(&homeTarget, axis) - *axisValue(&homeClearance, axis);
+    positionVersion++;
+    *phase = HOME_RELEASE;
+  }
+  else
+  {
+    *phase = HOME_BACK_OFF;
+  }
+}
+
+//Update the position for a joystick step and schedule the next one.
+void countStep(volatile StepTimer *timer, volatile long *position, long direction)
+{
+  if(direction){(*position)++;}else{(*position)--;}
+  positionVersion++;
+  scheduleStep(timer);
+}
+
+//One tick of a coordinated move, from the lead axis timer. Every axis that is
+//due steps in the same interupt, so the stage follows the straight line.
+//On the last step of a segment the next one is loaded, which may start a new
+//line on another lead axis.
+void lineStep(volatile StepTimer *timer)
+{
+  uint8_t xStep = 0;
+  uint8_t yStep = 0;
+  uint8_t zStep = 0;
+  
+  if(isLineStepDue(&moveLine.x, moveLine.total) && !(frozenAxes & AXIS_MASK(AXIS_X)))
+  {
+    xStep = PIN_MASK(motorX_step);
+    if(axisDirection.x){actualPosition.x++;}else{actualPosition.x--;}
+  }
+  
+  if(isLineStepDue(&moveLine.y, moveLine.total) && !(frozenAxes & AXIS_MASK(AXIS_Y)))
+  {
+    yStep = PIN_MASK(motorY_step);
+    if(axisDirection.y){actualPosition.y++;}else{actualPosition.y--;}
+  }
+  
+  if(isLineStepDue(&moveLine.z, moveLine.total) && !(frozenAxes & AXIS_MASK(AXIS_Z)))
+  {
+    zStep = PIN_MASK(motorZ_step);
+    if(axisDirection.z){actualPosition.z++;}else{actualPosition.z--;}
+  }
+  positionVersion++;
+  
+  //the lead axis timer has made its own pulse. Its pin goes back to the port
+  //bit when the timer stops, so that bit has to stay low.
+  if(HARDWARE_STEPS)
   {
-   inputs->x = (inputs->x * inputs->x) / perSecRatio;
+    if(moveLine.lead == AXIS_X){xStep = 0;}
+    else if(moveLine.lead == AXIS_Y){yStep = 0;}
+    else {zStep = 0;}
+  }
+  
+  //the TTL output goes with the first step of a segment that asks for it.
+  uint8_t trigger = moveSegment.trigger;
+  moveSegment.trigger = false;
+  if(trigger){*PIN_PORT(ttl_output) |= PIN_MASK(ttl_output);}
+  
+  raiseStepPins(xStep, yStep, zStep);
+  int more = --moveSegment.steps > 0 || haltRamping;
+  if(more)
+  {
+    scheduleStep(timer);
+  }
+  lowerStepPins();
+  if(trigger){*PIN_PORT(ttl_output) &= ~PIN_MASK(ttl_output);}
+  if(more)
+  {
+    return;
+  }
+  
+  //the direction pins only change once the step pins are low again.
+  if(!takeSegment(&moveSegment, &moveLine))
+  {
+    //out of segments, the foreground starts the stage again if there is more.
+    stopStepTimer(timer);
+    moveInProgress = false;
+    moveComplete = true;
+    return;
+  }
+  setSegmentDirections();
+  volatile StepTimer *lead = leadStepTimer();
+  if(lead != timer)
+  {
+    stopStepTimer(timer);
+    startStepTimer(lead, moveSegment.interval);
   }
   else
   {
-    inputs->x = 0;
+    timer->interval = moveSegment.interval;
+    scheduleStep(timer);
+  }
+}
+
+//Start the step interupt on the segment buffer if it is stopped and there are
+//segments waiting. The first step goes out straight away.
+void startSegments()
+{
+  noInterrupts();
+  if(!moveInProgress && !haltRamping && takeSegment(&moveSegment, &moveLine))
+  {
+    setSegmentDirections();
+    moveInProgress = true;
+    wakeStepTimer();
+    setStepInterval(leadStepTimer(), moveSegment.interval);
   }
+  interrupts();
+}
 
-  if(abs(inputs->y) > dead_zone)
+//Set the direction pins at the start of each line.
+void setSegmentDirections()
+{
+  if(!moveSegment.newLine)
   {
-    inputs->y = (inputs->y * inputs->y) / perSecRatio;
+    return;
+  }
+  uint8_t directions = moveSegment.directions;
+  axisDirection.x = setDir(directions & SEGMENT_DIR(AXIS_X), PIN_PORT(motorX_dir), PIN_MASK(motorX_dir));
+  axisDirection.y = setDir(directions & SEGMENT_DIR(AXIS_Y), PIN_PORT(motorY_dir), PIN_MASK(motorY_dir));
+  axisDirection.z = setDir(directions & SEGMENT_DIR(AXIS_Z), PIN_PORT(motorZ_dir), PIN_MASK(motorZ_dir));
+  applyLockouts();
+}
+
+volatile StepTimer *leadStepTimer()
+{
+  return axisStepTimer(moveLine.lead);
+}
+
+volatile StepTimer *axisStepTimer(int axis)
+{
+  if(axis == AXIS_Y){return &stepTimer.y;}
+  if(axis == AXIS_Z){return &stepTimer.z;}
+  return &stepTimer.x;
+}
+
+//One axis of the settings, by axis number.
+volatile long *axisValue(volatile AxisSettings *settings, int axis)
+{
+  if(axis == AXIS_Y){return &settings->y;}
+  if(axis == AXIS_Z){return &settings->z;}
+  return &settings->x;
+}
+
+long *axisValue(AxisSettings *settings, int axis)
+{
+  if(axis == AXIS_Y){return &settings->y;}
+  if(axis == AXIS_Z){return &settings->z;}
+  return &settings->x;
+}
+
+int homeSwitchClosed(int axis)
+{
+  if(axis == AXIS_Y){return !(*PIN_INPUT(motorY_lockout) & PIN_MASK(motorY_lockout));}
+  if(axis == AXIS_Z){return !(*PIN_INPUT(motorZ_lockout) & PIN_MASK(motorZ_lockout));}
+  return !(*PIN_INPUT(motorX_lockout) & PIN_MASK(motorX_lockout));
+}
+
+//Stop an axis and set it going at rate steps per second, positive or not.
+//The ramp timer picks the new speed up on its next tick.
+void setHomeSpeed(int axis, long rate, int positive)
+{
+  noInterrupts();
+  stopStepTimer(axisStepTimer(axis));
+  if(axis == AXIS_X){axisDirection.x = setDir(positive, PIN_PORT(motorX_dir), PIN_MASK(motorX_dir));}
+  if(axis == AXIS_Y){axisDirection.y = setDir(positive, PIN_PORT(motorY_dir), PIN_MASK(motorY_dir));}
+  if(axis == AXIS_Z){axisDirection.z = setDir(positive, PIN_PORT(motorZ_dir), PIN_MASK(motorZ_dir));}
+  applyLockouts();
+  *axisValue(&axisSpeed, axis) = rate;
+  interrupts();
+  wakeStepTimer();
+}
+
+//Step pins that share a port are written together so their edges go out at
+//the same time. The port comparisons are between constants, so the compiler
+//keeps only the branch that matches the pin assignments.
+void raiseStepPins(uint8_t xStep, uint8_t yStep, uint8_t zStep)
+{
+  volatile uint8_t *xPort = PIN_PORT(motorX_step);
+  volatile uint8_t *yPort = PIN_PORT(motorY_step);
+  volatile uint8_t *zPort = PIN_PORT(motorZ_step);
+  
+  if(xPort == yPort && yPort == zPort)
+  {
+    *xPort |= xStep | yStep | zStep;
+  }
+  else if(xPort == yPort)
+  {
+    *xPort |= xStep | yStep;
+    *zPort |= zStep;
+  }
+  else if(xPort == zPort)
+  {
+    *xPort |= xStep | zStep;
+    *yPort |= yStep;
+  }
+  else if(yPort == zPort)
+  {
+    *xPort |= xStep;
+    *yPort |= yStep | zStep;
   }
   else
   {
-    inputs->y = 0;
+    *xPort |= xStep;
+    *yPort |= yStep;
+    *zPort |= zStep;
   }
+}
 
-  if(abs(inputs->z) > dead_zone)
+void lowerStepPins()
+{
+  uint8_t xStep = PIN_MASK(motorX_step);
+  uint8_t yStep = PIN_MASK(motorY_step);
+  uint8_t zStep = PIN_MASK(motorZ_step);
+  volatile uint8_t *xPort = PIN_PORT(motorX_step);
+  volatile uint8_t *yPort = PIN_PORT(motorY_step);
+  volatile uint8_t *zPort = PIN_PORT(motorZ_step);
+  
+  if(xPort == yPort && yPort == zPort)
+  {
+    *xPort &= ~(xStep | yStep | zStep);
+  }
+  else if(xPort == yPort)
+  {
+    *xPort &= ~(xStep | yStep);
+    *zPort &= ~zStep;
+  }
+  else if(xPort == zPort)
+  {
+    *xPort &= ~(xStep | zStep);
+    *yPort &= ~yStep;
+  }
+  else if(yPort == zPort)
   {
-    inputs->z = (inputs->z * inputs->z) / perSecRatio;
+    *xPort &= ~xStep;
+    *yPort &= ~(yStep | zStep);
   }
   else
   {
-    inputs->z = 0;
+    *xPort &= ~xStep;
+    *yPort &= ~yStep;
+    *zPort &= ~zStep;
   }
+}
+
+//Called by AsiMS2000 when a MOVE or MOVREL changes the desired position.
+//Queues a straight line from the end of the last queued move to the new
+//position. Queued moves run one after another without stopping at each
+//corner, unless the corner is too sharp.
+//Every axis finishes moving in the positive direction, so the gears and lead
+//screws always take up their slack the same way. An axis with a BACKLASH set
+//that has to go the other way runs past the target by BACKLASH plus OVERSHOOT
+//(mm) and comes back to it in a second line, all in the same move.
+void startMove()
+{
+  if(homing)
+  {
+    homeMovePending = true;
+    return;
+  }
+  AxisSettings desired = AsiMS2000.getDesiredSteps();
+  startQueue();
+  
+  AxisSettings steps;
+  steps.x = desired.x - queuedPosition.x;
+  steps.y = desired.y - queuedPosition.y;
+  steps.z = desired.z - queuedPosition.z;
+  if(steps.x == 0 && steps.y == 0 && steps.z == 0)
+  {
+    moveComplete = true;
+    return;
+  }
+  
+  AxisSettingsF backlash = AsiMS2000.getBacklash();
+  AxisSettingsF overshoot = AsiMS2000.getOvershoot();
+  AxisSettingsF stepsPerMm = AsiMS2000.getStepsPerMm();
+  AxisSettings approach;
+  approach.x = approachSteps(steps.x, backlash.x, overshoot.x, stepsPerMm.x);
+  approach.y = approachSteps(steps.y, backlash.y, overshoot.y, stepsPerMm.y);
+  approach.z = approachSteps(steps.z, backlash.z, overshoot.z, stepsPerMm.z);
   
+  steps.x -= approach.x;
+  steps.y -= approach.y;
+  steps.z -= approach.z;
+  queueLineMove(&steps, false);
+  if(approach.x != 0 || approach.y != 0 || approach.z != 0)
+  {
+    queueLineMove(&approach, false);
+  }
+  queuedPosition = desired;
 }
 
-//This method is called automatically a number of times equall to intPerSec
-//The motors are pulses only here and the position of the axis is updated.
-void motorCallback()
+//With nothing queued the stage is wherever the joysticks left it, so stop
+//them and start the queue from there.
+void startQueue()
 {
-    moveToDesired();
-    digitalWrite(motorX_step, LOW);
-    digitalWrite(motorY_step, LOW);
-    digitalWrite(motorZ_step, LOW);
-    
-    interupts++;
-    long ma_mod = intPerSec/axisSpeed.x;
-    long mb_mod = intPerSec/axisSpeed.y;
-    long mc_mod = intPerSec/axisSpeed.z;
-   
-   
-    if(axisSpeed.x > 0 && interupts % ma_mod == 0)
+  noInterrupts();
+  if(!moveInProgress && !moveSegmentsPending())
+  {
+    axisSpeed.x = 0;
+    axisSpeed.y = 0;
+    axisSpeed.z = 0;
+    stopStepTimer(&stepTimer.x);
+    stopStepTimer(&stepTimer.y);
+    stopStepTimer(&stepTimer.z);
+    queuedPosition.x = actualPosition.x;
+    queuedPosition.y = actualPosition.y;
+    queuedPosition.z = actualPosition.z;
+  }
+  interrupts();
+}
+
+//Queue a line of steps, with a pulse on the TTL output as it starts if trigger is set.
+//The line speed is the lowest SPEED (mm/s) of the axes that move, so no
+//axis goes faster than its own setting. The ramps take the longest ACCEL
+//(ms to reach speed) of those axes and are S-curves if any of them has
+//SCURVE set.
+void queueLineMove(AxisSettings *steps, int trigger)
+{
+  AxisSettingsF maxSpeed = AsiMS2000.getMaxSpeed();
+  AxisSettingsF stepsPerMm = AsiMS2000.getStepsPerMm();
+  AxisSettings accel = AsiMS2000.getAccel();
+  AxisSettings sCurve = AsiMS2000.getSCurve();
+  
+  float speed = 0;
+  long accelTime = 0;
+  int useSCurve = false;
+  limitLineAxis(steps->x, maxSpeed.x, accel.x, sCurve.x, &speed, &accelTime, &useSCurve);
+  limitLineAxis(steps->y, maxSpeed.y, accel.y, sCurve.y, &speed, &accelTime, &useSCurve);
+  limitLineAxis(steps->z, maxSpeed.z, accel.z, sCurve.z, &speed, &accelTime, &useSCurve);
+  
+  //SPEED is along the line in mm, the queue works along it in steps. Each
+  //axis has its own steps per mm.
+  float mmX = steps->x / stepsPerMm.x;
+  float mmY = steps->y / stepsPerMm.y;
+  float mmZ = steps->z / stepsPerMm.z;
+  float mm = sqrt(mmX * mmX + mmY * mmY + mmZ * mmZ);
+  float length = sqrt((float)steps->x * steps->x + (float)steps->y * steps->y + (float)steps->z * steps->z);
+  queueMove(steps, speed * length / mm, accelTime, useSCurve, trigger, rampTicksPerSec);
+}
+
+//Fold the settings of one axis into the line limits, if the axis moves.
+void limitLineAxis(long steps, float maxSpeed, long accel, int sCurve, float *speed, long *accelTime, int *useSCurve)
+{
+  if(steps == 0)
+  {
+    return;
+  }
+  if(*speed == 0 || maxSpeed < *speed)
+  {
+    *speed = maxSpeed;
+  }
+  if(accel > *accelTime)
+  {
+    *accelTime = accel;
+  }
+  if(sCurve)
+  {
+    *useSCurve = true;
+  }
+}
+
+//Called by AsiMS2000 when SCAN starts the raster scan set up by SCANR and SCANV.
+//X is the fast axis and crosses the SCANR range at its SPEED, Y steps
+//between the lines.
+void startScan()
+{
+  if(homing)
+  {
+    homeScanPending = true;
+    return;
+  }
+  AxisSettingsF range = AsiMS2000.getScanRange();
+  AxisSettingsF lines = AsiMS2000.getScanLines();
+  AxisSettingsF maxSpeed = AsiMS2000.getMaxSpeed();
+  AxisSettingsF stepsPerMm = AsiMS2000.getStepsPerMm();
+  AxisSettings accel = AsiMS2000.getAccel();
+  
+  //the lines run along X and step along Y.
+  scanStart = lround(range.x * stepsPerMm.x);
+  scanStop = lround(range.y * stepsPerMm.x);
+  scanSlowStart = lround(lines.x * stepsPerMm.y);
+  scanSlowStop = lround(lines.y * stepsPerMm.y);
+  scanLines = (long)lines.z;
+  scanPattern = AsiMS2000.getScanPattern();
+  
+  //the ramp up takes ACCEL ms at an even acceleration, so covers speed * ACCEL / 2000
+  //steps. A quarter more makes sure the range starts at full speed.
+  float speed = min(maxSpeed.x * stepsPerMm.x, (float)MAX_STEP_RATE);
+  scanRunUp = (long)(speed * accel.x / 2000.0 * 1.25) + 1;
+  
+  startQueue();
+  scanLine = 0;
+  scanning = true;
+  continueScan();
+}
+
+//Called by AsiMS2000 when HOME asks for the home switches of some axes.
+//Ends any scan. The moves already queued finish first.
+void startHoming()
+{
+  AxisSettingsF maxSpeed = AsiMS2000.getMaxSpeed();
+  AxisSettingsF stepsPerMm = AsiMS2000.getStepsPerMm();
+  homeTarget = AsiMS2000.getHomePosition();
+  
+  //stop far enough off the switch for an anti-backlash approach to home.
+  AxisSettingsF backlash = AsiMS2000.getBacklash();
+  AxisSettingsF overshoot = AsiMS2000.getOvershoot();
+  homeClearance.x = homeBackOff + approachSteps(-1, backlash.x, overshoot.x, stepsPerMm.x);
+  homeClearance.y = homeBackOff + approachSteps(-1, backlash.y, overshoot.y, stepsPerMm.y);
+  homeClearance.z = homeBackOff + approachSteps(-1, backlash.z, overshoot.z, stepsPerMm.z);
+  homeSeekRate.x = min((long)(maxSpeed.x * stepsPerMm.x), MAX_STEP_RATE);
+  homeSeekRate.y = min((long)(maxSpeed.y * stepsPerMm.y), MAX_STEP_RATE);
+  homeSeekRate.z = min((long)(maxSpeed.z * stepsPerMm.z), MAX_STEP_RATE);
+  homeMaxTravel.x = (long)(stageTravel * stepsPerMm.x);
+  homeMaxTravel.y = (long)(stageTravel * stepsPerMm.y);
+  homeMaxTravel.z = (long)(stageTravel * stepsPerMm.z);
+  homeAxes = AsiMS2000.getHomeAxes();
+  scanning = false;
+  homing = true;
+  homeStarted = false;
+}
+
+//Take each homing axis on to its next stage once it is ready, called from loop().
+//The phases are written by the step interupts too, but only once the axis
+//has stopped, so there's no race over them here.
+void continueHoming()
+{
+  if(!homing)
+  {
+    return;
+  }
+  if(!homeStarted)
+  {
+    if(moveInProgress || moveSegmentsPending())
     {
-      digitalWrite(motorX_step, HIGH);
-      if(axisDirection.x){actualPosition.x++;}else{actualPosition.x--;}       
+      return;
     }
-    
-    if(axisSpeed.y > 0 && interupts % mb_mod == 0)
+    startQueue();
+    homeStarted = true;
+    homeStartTime = millis();
+    AxisSettings start = AsiMS2000.getCurrentPos();
+    for(int axis = AXIS_X; axis <= AXIS_Z; axis++)
     {
-      digitalWrite(motorY_step, HIGH);
-      if(axisDirection.y){actualPosition.y++;}else{actualPosition.y--;}
+      if(!*axisValue(&homeAxes, axis))
+      {
+        continue;
+      }
+      *axisValue(&homeRunFrom, axis) = *axisValue(&start, axis);
+      if(homeSwitchClosed(axis))
+      {
+        *axisValue(&homePhase, axis) = HOME_BACK_OFF;
+      }
+      else
+      {
+        *axisValue(&homePhase, axis) = HOME_SEEK;
+        setHomeSpeed(axis, homeSlowRate, false);
+      }
     }
-    
-    if(axisSpeed.z > 0 && interupts % mc_mod == 0)
+  }
+  
+  int done = true;
+  for(int axis = AXIS_X; axis <= AXIS_Z; axis++)
+  {
+    if(homeTooFar(axis))
     {
-      digitalWrite(motorZ_step, HIGH);
-      if(axisDirection.z){actualPosition.z++;}else{actualPosition.z--;}
+      noInterrupts();
+      *axisValue(&lockoutFault, axis) = true;
+      interrupts();
+      stopHoming();
+      moveComplete = true;
+      return;
     }
-    
-    AsiMS2000.setCurrentPos(actualPositionToF());
-}
-
-//If a move order from the serial interface is in progress,
-//calculate if more movenment is needs and in what direction.
-void moveToDesired()
-{
-  if(!AsiMS2000.getBusyStatus())
+    if(!continueHomingAxis(axis))
+    {
+      done = false;
+    }
+  }
+  if(!done)
   {
     return;
   }
   
-  AxisSettingsF desired = AsiMS2000.getDesiredPos();  
-  AxisSettingsF actualF = actualPositionToF();
-  int isAtDesired = true;
+  homing = false;
+  moveComplete = true;
+  if(homeMovePending)
+  {
+    homeMovePending = false;
+    startMove();
+  }
+  if(homeScanPending)
+  {
+    homeScanPending = false;
+    startScan();
+  }
+}
+
+//True if a homing axis has run further than it could without finding its
+//switch, or the switch opening again. Homing gives up then, and the fault
+//shows on RDSTAT.
+int homeTooFar(int axis)
+{
+  AxisSettings current = AsiMS2000.getCurrentPos();
+  long position = *axisValue(&current, axis);
+  long from = *axisValue(&homeRunFrom, axis);
   
-  if(!isWithinTolerance(actualF.x, desired.x, moveTolerance))
-  {    
-    axisDirection.x = setDir(desired.x - actualF.x, motorX_dir);
-    axisSpeed.x = intPerSec;
-    isAtDesired = false;
+  switch(*axisValue(&homePhase, axis))
+  {
+    case HOME_SEEK:
+      return from - position > *axisValue(&homeMaxTravel, axis);
+    case HOME_BACK_OFF:
+      return position - from > *axisValue(&homeMaxTravel, axis);
+    case HOME_LOCATE:
+      return *axisValue(&homeClearFrom, axis) - position > homeBackOff;
   }
-  else
+  return false;
+}
+
+//Stop every homing axis where it is, with HOME and any move or scan that came
+//in while homing dropped.
+void stopHoming()
+{
+  homing = false;
+  homeMovePending = false;
+  homeScanPending = false;
+  for(int axis = AXIS_X; axis <= AXIS_Z; axis++)
   {
-    axisSpeed.x = 0;
+    *axisValue(&homePhase, axis) = HOME_IDLE;
+    setHomeSpeed(axis, 0, false);
   }
+}
+
+//Returns true once the axis has finished homing, or wasn't asked to.
+int continueHomingAxis(int axis)
+{
+  volatile long *phase = axisValue(&homePhase, axis);
+  AxisSettings current = AsiMS2000.getCurrentPos();
+  long position = *axisValue(&current, axis);
   
-  if(!isWithinTolerance(actualF.y, desired.y, moveTolerance))
+  switch(*phase)
   {
-    axisDirection.y = setDir(desired.y - actualF.y, motorY_dir);
-    axisSpeed.y = intPerSec;
-    isAtDesired = false;
+    case HOME_SEEK:
+    {
+      //run up to speed over the ACCEL time of the axis.
+      AxisSettings accelTime = AsiMS2000.getAccel();
+      long accel = *axisValue(&accelTime, axis);
+      long rate = *axisValue(&homeSeekRate, axis);
+      unsigned long time = millis() - homeStartTime;
+      if(accel > 0 && time < (unsigned long)accel)
+      {
+        rate = max((long)((float)rate * time / accel), homeSlowRate);
+      }
+      noInterrupts();
+      if(*phase == HOME_SEEK)
+      {
+        *axisValue(&axisSpeed, axis) = rate;
+      }
+      interrupts();
+      return false;
+    }
+    case HOME_BACK_OFF:
+      if(*axisValue(&axisSpeed, axis) == 0)
+      {
+        *axisValue(&homeRunFrom, axis) = position;
+        setHomeSpeed(axis, homeSlowRate, true);
+      }
+      else if(!homeSwitchClosed(axis))
+      {
+        *axisValue(&homeClearFrom, axis) = position;
+        *phase = HOME_CLEAR;
+      }
+      return false;
+    case HOME_CLEAR:
+      if(position - *axisValue(&homeClearFrom, axis) >= homeBackOff)
+      {
+        *phase = HOME_LOCATE;
+        setHomeSpeed(axis, homeSlowRate, false);
+      }
+      return false;
+    case HOME_LOCATE:
+      return false;
+    case HOME_RELEASE:
+    {
+      //the interupt stops the axis at homeTarget, only start it off.
+      noInterrupts();
+      int start = *phase == HOME_RELEASE && *axisValue(&axisSpeed, axis) == 0;
+      interrupts();
+      if(start)
+      {
+        setHomeSpeed(axis, homeSlowRate, true);
+      }
+      return false;
+    }
+    case HOME_FOUND:
+      noInterrupts();
+      *phase = HOME_IDLE;
+      applyLockouts();
+      interrupts();
+      return true;
   }
-  else
+  return true;
+}
+
+//Called by AsiMS2000 on a HALT. Drops the queued moves and any scan and
+//ramps the stage down from the speed it is going at, along the line it is on,
+//at the acceleration of the move it is running. The ramp interupt may have
+//started the ramp already. Homing axes stop at once. loop() clears busy once
+//the stage has stopped.
+void haltMove()
+{
+  scanning = false;
+  halting = true;
+  if(homing)
   {
-    axisSpeed.y = 0;
+    stopHoming();
   }
   
-  if(!isWithinTolerance(actualF.z, desired.z, moveTolerance))
+  noInterrupts();
+  startHaltRamp();
+  interrupts();
+  clearMoveQueue();
+  stopSegments();
+  moveComplete = true;
+}
+
+//Start the ramp down from the speed of the segment the step interupt is on.
+//Called with the interupts off.
+void startHaltRamp()
+{
+  if(!moveInProgress || haltRamping)
   {
-    axisDirection.z = setDir(desired.z - actualF.z, motorZ_dir);
-    axisSpeed.z = intPerSec;
-    isAtDesired = false;
+    return;
   }
-  else
+  haltRamping = true;
+  planStopRamp(&haltRamp, F_CPU / moveSegment.interval, moveSegment.accel, rampTicksPerSec);
+}
+
+//One tick of the ramp down, from the ramp interupt.
+void runHaltRamp()
+{
+  volatile StepTimer *lead = leadStepTimer();
+  long rate = stopRampTick(&haltRamp);
+  if(rate == 0)
   {
-    axisSpeed.z = 0;
+    stopStepTimer(lead);
+    moveInProgress = false;
+    moveComplete = true;
+    return;
   }
   
-  if(isAtDesired)
+  //let the step interupt in during the division.
+  sei();
+  unsigned long interval = F_CPU / min(rate, MAX_STEP_RATE);
+  cli();
+  setStepInterval(lead, interval);
+}
+
+//Queue the next lines of the scan while there is room. Each line is a move to
+//the start of the run up, the run up, the range at a constant speed with a
+//pulse on the TTL output as it starts, and the run out. The first move of the
+//scan pulses the TTL output too.
+void continueScan()
+{
+  while(scanning && moveQueueSpace() >= scanMovesPerLine)
   {
-    AsiMS2000.clearBusyStatus();
+    long y = scanSlowStart;
+    if(scanLines > 1)
+    {
+      //span * scanLine would overflow a long on long scans, so the whole
+      //line spacing and the part left over are scaled separately.
+      ldiv_t spacing = ldiv(scanSlowStop - scanSlowStart, scanLines - 1);
+      y += spacing.quot * scanLine + spacing.rem * scanLine / (scanLines - 1);
+    }
+    long from = scanStart;
+    long to = scanStop;
+    if(scanPattern == SCAN_SERPENTINE && scanLine % 2 == 1)
+    {
+      from = scanStop;
+      to = scanStart;
+    }
+    long runUp = to > from ? scanRunUp : -scanRunUp;
+    
+    int scanPulse = scanLine == 0;
+    if(queueScanMove(from - runUp, y, scanPulse))
+    {
+      scanPulse = false;
+    }
+    queueScanMove(from, y, scanPulse);
+    queueScanMove(to, y, true);
+    queueScanMove(to + runUp, y, false);
+    
+    if(++scanLine >= scanLines)
+    {
+      scanning = false;
+      AxisSettings desired = AsiMS2000.getDesiredSteps();
+      desired.x = queuedPosition.x;
+      desired.y = queuedPosition.y;
+      AsiMS2000.setDesiredSteps(desired);
+    }
+  }
+}
+
+//Queue a move of the scan to x, y. Returns false if it is already there.
+int queueScanMove(long x, long y, int trigger)
+{
+  AxisSettings steps;
+  steps.x = x - queuedPosition.x;
+  steps.y = y - queuedPosition.y;
+  steps.z = 0;
+  if(steps.x == 0 && steps.y == 0)
+  {
+    return false;
   }
+  queueLineMove(&steps, trigger);
+  queuedPosition.x = x;
+  queuedPosition.y = y;
+  return true;
 }
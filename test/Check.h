@@ -0,0 +1,32 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//Checks for the host tests. A failed check is reported and counted, the test
+//carries on.
+
+#ifndef Check_h
+#define Check_h
+
+#define CHECK(condition) checkThat((condition), #condition, __FILE__, __LINE__)
+
+void checkThat(int passed, const char *what, const char *file, int line);
+
+void testLines();
+void testProfiles();
+void testMoveTimes();
+void testSettleTimes();
+void testSegments();
+void testTiles();
+void testHaltLatency();
+void testCommandLine();
+void testCommands();
+void testCommandInput();
+void testBaud();
+void dumpTrajectories();
+
+#endif
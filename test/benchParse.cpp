@@ -0,0 +1,148 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//Commands a second parsed by the String parser AsiMS2000 used to have and by
+//tokenizeCommand, run "make bench" here. Each command is split up, checked for
+//a query and the X, Y and Z arguments, and has their values read, the way
+//the command handlers use it.
+
+#include <Arduino.h>
+#include <time.h>
+#include "WString.h"
+#include "CommandLine.h"
+#include "AsiSettings.h"
+
+volatile float sum = 0;//keeps the values from being optimized away.
+
+//A mix of what a host sends while it runs the stage.
+static const char *lines[] = {
+  "W X Y", "/", "M X=1234.5 Y=-20 Z=3", "S X? Y?", "B X=0.05",
+  "JS X=1", "WHERE X Y Z", "MOVREL X=10 Y=10", "STATUS", "ACCEL X=100 Y=100 Z=100"
+};
+#define LINES (sizeof(lines) / sizeof(lines[0]))
+#define REPEATS 20000
+
+//The parser as it was, on String.
+struct StringParse
+{
+  String args;
+  int isQuery;
+  AxisSettings isAxis;
+  
+  void parse(char commandBuffer[])
+  {
+    String c = String(commandBuffer);
+    int s = c.indexOf(' ');
+    String base;
+    if(s > 0)
+    {
+      base = c.substring(0,s);
+      args = c.substring(s);
+      args.toUpperCase();
+    }
+    else
+    {
+      base = c;
+      args = "";
+    }
+    isQuery = isQueryCommand(c);
+    isAxisInCommand();
+  }
+  
+  void isAxisInCommand()
+  {
+    isAxis.x = false;
+    isAxis.y = false;
+    isAxis.z = false;
+    for(unsigned int i = 0; i < args.length(); i++)
+    {
+      if(args[i] == 'X') {isAxis.x = true;} 
+      if(args[i] == 'Y') {isAxis.y = true;}
+      if(args[i] == 'Z') {isAxis.z = true;}
+    }
+  }
+  
+  int isQueryCommand(String command)
+  {
+    for(unsigned int i = 0; i < command.length(); i++)
+    {
+      if(command.charAt(i) == '?')
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  //the old one returned its own stack buffer, here the caller gives one.
+  const char *argumentValue(char arg, char *buffer)
+  {
+    int argIndex = args.indexOf(arg);
+    if(argIndex == -1)
+    {
+      return "0";
+    }
+    int bIndex = 0;
+    while(args.charAt(argIndex) != ' ' && argIndex < (int)args.length())
+    {
+      argIndex++;
+      if(args.charAt(argIndex) != '=')
+      {
+        buffer[bIndex++] = args.charAt(argIndex);
+      }
+    }
+    buffer[bIndex] = '\0';
+    return buffer;
+  }
+};
+
+static float secondsSince(clock_t start)
+{
+  return (float)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+  char line[STRING_LENGTH + 1];
+  long commands = (long)LINES * REPEATS;
+  
+  StringParse old;
+  clock_t start = clock();
+  for(long i = 0; i < commands; i++)
+  {
+    strcpy(line, lines[i % LINES]);
+    old.parse(line);
+    char buffer[20];
+    if(old.isAxis.x) {sum += atof(old.argumentValue('X', buffer));}
+    if(old.isAxis.y) {sum += atof(old.argumentValue('Y', buffer));}
+    if(old.isAxis.z) {sum += atof(old.argumentValue('Z', buffer));}
+    sum += old.isQuery;
+  }
+  float oldSeconds = secondsSince(start);
+  long oldAllocations = stringAllocations;
+  
+  CommandLine command;
+  start = clock();
+  for(long i = 0; i < commands; i++)
+  {
+    strcpy(line, lines[i % LINES]);
+    tokenizeCommand(line, &command);
+    if(hasArgument(&command, 'X')) {sum += atof(argumentValue(&command, 'X'));}
+    if(hasArgument(&command, 'Y')) {sum += atof(argumentValue(&command, 'Y'));}
+    if(hasArgument(&command, 'Z')) {sum += atof(argumentValue(&command, 'Z'));}
+    sum += command.isQuery;
+  }
+  float newSeconds = secondsSince(start);
+  
+  printf("parsing %ld commands\n", commands);
+  printf("  String parser    %9.0f commands/s  %.2f String allocations a command\n",
+    commands / oldSeconds, (float)oldAllocations / commands);
+  printf("  tokenizeCommand  %9.0f commands/s  %.2f String allocations a command\n",
+    commands / newSeconds, (float)(stringAllocations - oldAllocations) / commands);
+  return 0;
+}
@@ -0,0 +1,45 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//The parts of the Arduino core the stubs declare.
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+volatile uint8_t SREG = 0;
+long stringAllocations = 0;
+HardwareSerial Serial;
+HardwareSerial Serial1;
+unsigned long testMillis = 0;
+uint8_t eeprom[EEPROM_LENGTH];
+
+unsigned long millis()
+{
+  return testMillis;
+}
+
+//the EEPROM starts blank, as on a new board.
+static struct BlankEeprom {BlankEeprom() {memset(eeprom, 0xFF, sizeof(eeprom));}} blankEeprom;
+
+uint32_t eeprom_read_dword(const uint32_t *address)
+{
+  uint32_t value;
+  memcpy(&value, eeprom + (uintptr_t)address, sizeof(value));
+  return value;
+}
+
+void eeprom_update_dword(uint32_t *address, uint32_t value)
+{
+  memcpy(eeprom + (uintptr_t)address, &value, sizeof(value));
+}
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *text)
+{
+  sprintf(text, "%*.*f", width, precision, value);
+  return text;
+}
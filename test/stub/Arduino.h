@@ -0,0 +1,47 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//Just enough of the Arduino core to build the sketch's modules on a PC for
+//the tests.
+
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef abs
+#define abs(x) ((x)>0?(x):-(x))
+#endif
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+//the tests have no interupts to hold off.
+#define noInterrupts()
+#define interrupts()
+
+//the time the tests have got to, millis() doesn't move by itself.
+extern unsigned long testMillis;
+unsigned long millis();
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *text);
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "WString.h"
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,54 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//A serial port the tests type into and read the replies back from.
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+#include <string.h>
+
+#define SERIAL_LENGTH 512
+
+class HardwareSerial
+{
+  public:
+    HardwareSerial() {_received[0] = '\0'; _sent[0] = '\0';}
+    
+    void begin(long rate) {_baud = rate;}
+    void flush() {}
+    int available() {return strlen(_received) - _read;}
+    int read() {return available() > 0 ? _received[_read++] : -1;}
+    void print(const char *text) {strncat(_sent, text, SERIAL_LENGTH - strlen(_sent));}
+    void println(const char *text) {print(text); print("\r\n");}
+    
+    //the text the next reads get.
+    void receive(const char *text)
+    {
+      strncpy(_received, text, SERIAL_LENGTH);
+      _received[SERIAL_LENGTH] = '\0';
+      _read = 0;
+    }
+    
+    //the rate of the last begin().
+    long baud() {return _baud;}
+    
+    //everything printed since the last clearSent().
+    const char *sent() {return _sent;}
+    void clearSent() {_sent[0] = '\0';}
+    
+  private:
+    long _baud = 0;
+    char _received[SERIAL_LENGTH + 1];
+    int _read = 0;
+    char _sent[SERIAL_LENGTH + 1];
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,108 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//Just enough of the Arduino String for AsiMS2000.cpp and the parser
+//benchmark. The text is kept in a fixed buffer, but every String given text
+//and every append counts as a heap allocation, as it would be on the MEGA.
+
+#ifndef WString_h
+#define WString_h
+#include <Arduino.h>
+
+#define STRING_LENGTH 128
+
+extern long stringAllocations;
+
+class String
+{
+  public:
+    String(const char *text = "") {set(text, strlen(text));}
+    String(const String &other) {set(other._text, other._length);}
+    String &operator=(const String &other) {set(other._text, other._length); return *this;}
+    String &operator=(const char *text) {set(text, strlen(text)); return *this;}
+    explicit String(int number) {setNumber(number);}
+    explicit String(long number) {setNumber(number);}
+    
+    unsigned char concat(const String &other) {append(other._text, other._length); return 1;}
+    unsigned char concat(const char *text) {append(text, strlen(text)); return 1;}
+    String &operator+=(const String &other) {concat(other); return *this;}
+    String &operator+=(const char *text) {concat(text); return *this;}
+    String &operator+=(char c) {append(&c, 1); return *this;}
+    String &operator+=(int number) {return *this += String(number);}
+    String &operator+=(long number) {return *this += String(number);}
+    friend String operator+(const String &left, const String &right) {String sum(left); sum += right; return sum;}
+    friend String operator+(const String &left, const char *right) {String sum(left); sum += right; return sum;}
+    friend String operator+(const char *left, const String &right) {String sum(left); sum += right; return sum;}
+    
+    unsigned int length() const {return _length;}
+    char charAt(unsigned int index) const {return index < _length ? _text[index] : 0;}
+    char operator[](unsigned int index) const {return charAt(index);}
+    
+    int indexOf(char c) const
+    {
+      const char *found = strchr(_text, c);
+      return found != NULL ? found - _text : -1;
+    }
+    
+    String substring(unsigned int from) const {return substring(from, _length);}
+    String substring(unsigned int from, unsigned int to) const
+    {
+      String part;
+      if(from < to && to <= _length)
+      {
+        part.set(_text + from, to - from);
+      }
+      return part;
+    }
+    
+    void toUpperCase()
+    {
+      for(unsigned int i = 0; i < _length; i++) {_text[i] = toupper(_text[i]);}
+    }
+    
+    unsigned char equalsIgnoreCase(const char *text) const {return strcasecmp(_text, text) == 0;}
+    
+    //copies all but the last character when size is the length, as on the MEGA.
+    void toCharArray(char *buffer, unsigned int size) const
+    {
+      if(size == 0) {return;}
+      unsigned int count = min(_length, size - 1);
+      memcpy(buffer, _text, count);
+      buffer[count] = '\0';
+    }
+    
+  private:
+    char _text[STRING_LENGTH + 1];
+    unsigned int _length;
+    
+    void set(const char *text, unsigned int length)
+    {
+      _length = min(length, (unsigned int)STRING_LENGTH);
+      memmove(_text, text, _length);
+      _text[_length] = '\0';
+      if(_length > 0) {stringAllocations++;}
+    }
+    
+    void setNumber(long number)
+    {
+      char text[12];
+      sprintf(text, "%ld", number);
+      set(text, strlen(text));
+    }
+    
+    void append(const char *text, unsigned int length)
+    {
+      length = min(length, STRING_LENGTH - _length);
+      memmove(_text + _length, text, length);
+      _length += length;
+      _text[_length] = '\0';
+      if(length > 0) {stringAllocations++;}
+    }
+};
+
+#endif
@@ -0,0 +1,22 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//An EEPROM in memory, blank (all 0xFF) until the tests write it.
+
+#ifndef eeprom_h
+#define eeprom_h
+#include <stdint.h>
+
+#define EEPROM_LENGTH 4096
+
+extern uint8_t eeprom[EEPROM_LENGTH];
+
+uint32_t eeprom_read_dword(const uint32_t *address);
+void eeprom_update_dword(uint32_t *address, uint32_t value);
+
+#endif
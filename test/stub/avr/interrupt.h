@@ -0,0 +1,17 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//Included by Timer16.h, the tests have no interupts.
+
+#ifndef interrupt_h
+#define interrupt_h
+
+#define cli()
+#define sei()
+
+#endif
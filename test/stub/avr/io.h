@@ -0,0 +1,24 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//The clock select bits named in Timer16.h and the status register
+//AsiMS2000.cpp saves around reading the serial port, so the sketch's modules
+//build for the tests. Nothing in the tests touches the timers.
+
+#ifndef io_h
+#define io_h
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define CS10 0
+#define CS11 1
+#define CS12 2
+
+extern volatile uint8_t SREG;
+
+#endif
@@ -0,0 +1,26 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+
+//A PC has no separate flash, the tables stay in memory and are read as is.
+
+#ifndef pgmspace_h
+#define pgmspace_h
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+#define strcmp_P(text, flash) strcmp((text), (flash))
+#define strcpy_P(text, flash) strcpy((text), (flash))
+#define strcat_P(text, flash) strcat((text), (flash))
+#define memcpy_P(to, flash, length) memcpy((to), (flash), (length))
+
+#endif
@@ -0,0 +1,62 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include <Arduino.h>
+#include "CommandLine.h"
+#include "Check.h"
+
+static int same(const char *a, const char *b)
+{
+  return strcmp(a, b) == 0;
+}
+
+//How command lines from the PC are split up.
+void testCommandLine()
+{
+  CommandLine command;
+  char move[] = "m x=1.5 y=-20 Z";
+  tokenizeCommand(move, &command);
+  CHECK(same(command.base, "M"));
+  CHECK(command.argumentCount == 3);
+  CHECK(!command.isQuery);
+  CHECK(command.arguments[0].name == 'X' && same(command.arguments[0].value, "1.5"));
+  CHECK(command.arguments[1].name == 'Y' && same(command.arguments[1].value, "-20"));
+  CHECK(command.arguments[2].name == 'Z' && same(command.arguments[2].value, ""));
+  CHECK(hasArgument(&command, 'Z'));
+  CHECK(!hasArgument(&command, 'F'));
+  CHECK(same(argumentValue(&command, 'Y'), "-20"));
+  CHECK(same(argumentValue(&command, 'F'), "0"));
+  
+  //a query anywhere marks the whole line, the value keeps the ?.
+  char speed[] = "S X?";
+  tokenizeCommand(speed, &command);
+  CHECK(same(command.base, "S"));
+  CHECK(command.isQuery);
+  CHECK(command.argumentCount == 1 && same(argumentValue(&command, 'X'), "?"));
+  
+  //spaces around and between the parts don't make arguments.
+  char spaced[] = "  JSSPD   x=50  y=10 ";
+  tokenizeCommand(spaced, &command);
+  CHECK(same(command.base, "JSSPD"));
+  CHECK(command.argumentCount == 2);
+  CHECK(same(argumentValue(&command, 'X'), "50") && same(argumentValue(&command, 'Y'), "10"));
+  
+  char bare[] = "/";
+  tokenizeCommand(bare, &command);
+  CHECK(same(command.base, "/") && command.argumentCount == 0 && !command.isQuery);
+  
+  char empty[] = "";
+  tokenizeCommand(empty, &command);
+  CHECK(same(command.base, "") && command.argumentCount == 0);
+  
+  //arguments past MAX_ARGUMENTS are left out.
+  char many[] = "ARRAY A=1 B=2 C=3 D=4 E=5 F=6 G=7 H=8 I=9";
+  tokenizeCommand(many, &command);
+  CHECK(command.argumentCount == MAX_ARGUMENTS);
+  CHECK(same(argumentValue(&command, 'H'), "8"));
+  CHECK(!hasArgument(&command, 'I'));
+}
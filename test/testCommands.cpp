@@ -0,0 +1,131 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include <Arduino.h>
+#include "AsiMS2000.h"
+#include "Check.h"
+
+static char reply[SERIAL_LENGTH + 1];
+
+//Type a command line at the controller and return what it answers.
+static const char *send(AsiMS2000 *asi, const char *line)
+{
+  Serial1.clearSent();
+  Serial1.receive(line);
+  for(unsigned int i = 0; i <= strlen(line); i++)
+  {
+    asi->checkSerial();
+  }
+  strcpy(reply, Serial1.sent());
+  return reply;
+}
+
+static int same(const char *a, const char *b)
+{
+  return strcmp(a, b) == 0;
+}
+
+//Commands are found by every one of their spellings.
+void testCommands()
+{
+  AsiMS2000 asi;
+  CHECK(same(send(&asi, "SETUP X=12.5\r"), ":A\r\n"));
+  CHECK(same(send(&asi, "SETUP X?\r"), ":A X=12.500000\r\n"));
+  CHECK(same(send(&asi, "SU X?\r"), ":A X=12.500000\r\n"));
+  CHECK(same(send(&asi, "setupper X?\r"), ":A X=12.500000\r\n"));
+  CHECK(same(send(&asi, "SETUPPER X=-3\r"), ":A\r\n"));
+  CHECK(same(send(&asi, "SU X?\r"), ":A X=-3.000000\r\n"));
+  
+  //settings the command table gets and sets, in both reply styles.
+  CHECK(same(send(&asi, "C Y?\r"), ":A Y=1600.000000\r\n"));
+  CHECK(same(send(&asi, "WT X=20\r"), ":A\r\n"));
+  CHECK(same(send(&asi, "WAIT X?\r"), ":X=20\r\n"));
+  
+  //the first and last lines of the table, and names either side of them.
+  CHECK(same(send(&asi, "! X\r"), ":A\r\n"));
+  CHECK(same(send(&asi, "~\r"), ":E-6\r\n"));//found, RESET is not done.
+  CHECK(same(send(&asi, "SETUPP X?\r"), ":E-1\r\n"));
+  CHECK(same(send(&asi, "SETUPPERS X?\r"), ":E-1\r\n"));
+  CHECK(same(send(&asi, "A\r"), ":E-1\r\n"));
+  CHECK(same(send(&asi, "~~\r"), ":E-1\r\n"));
+}
+
+//How much of the input each pass of loop() takes.
+void testCommandInput()
+{
+  AsiMS2000 asi;
+  char line[201];
+  
+  //a whole line runs in one call, but only one line.
+  Serial1.clearSent();
+  Serial1.receive("SU X=1\rSU X?\r");
+  asi.checkSerial();
+  CHECK(same(Serial1.sent(), ":A\r\n"));
+  asi.checkSerial();
+  CHECK(same(Serial1.sent(), ":A\r\n:A X=1.000000\r\n"));
+  
+  //a line too long for the buffer gets one error, and the next line still runs.
+  memset(line, 'X', 200);
+  strcpy(line + 200 - 8, "\rSU X?\r");
+  CHECK(same(send(&asi, line), ":E-6\r\n:A X=1.000000\r\n"));
+  memset(line, 'A', 127);
+  strcpy(line + 127, "\r");
+  CHECK(same(send(&asi, line), ":E-1\r\n"));//127 characters still fit.
+  memset(line, 'A', 128);
+  strcpy(line + 128, "\r");
+  CHECK(same(send(&asi, line), ":E-6\r\n"));
+  
+  //a HALT stops the call, the line ahead of it is thrown away and the ones
+  //after it wait for checkHalt().
+  Serial1.clearSent();
+  Serial1.receive("SU X=5\\\rSU X?\r");
+  asi.checkSerial();
+  CHECK(same(Serial1.sent(), ""));
+  asi.checkHalt();
+  CHECK(same(Serial1.sent(), ":A\r\n"));
+  asi.checkSerial();
+  CHECK(same(Serial1.sent(), ":A\r\n:A X=1.000000\r\n"));
+}
+
+//BAUD only keeps a rate once a command has come in at it.
+void testBaud()
+{
+  AsiMS2000 asi;
+  asi.begin();
+  CHECK(Serial1.baud() == 9600);//a blank EEPROM.
+  CHECK(same(send(&asi, "BAUD X?\r"), ":A X=9600\r\n"));
+  CHECK(same(send(&asi, "BAUD X=230400\r"), ":E-4\r\n"));
+  CHECK(same(send(&asi, "BD\r"), ":E-4\r\n"));
+  
+  //nothing arrives at the new rate, it goes back.
+  testMillis = 1000;
+  CHECK(same(send(&asi, "BAUD X=115200\r"), ":A\r\n"));
+  CHECK(Serial1.baud() == 115200);
+  testMillis = 5999;
+  asi.checkHalt();
+  CHECK(Serial1.baud() == 115200);
+  testMillis = 6000;
+  asi.checkHalt();
+  CHECK(Serial1.baud() == 9600);
+  asi.begin();
+  CHECK(Serial1.baud() == 9600);
+  
+  //a command arrives in time, the rate is kept for the next begin().
+  CHECK(same(send(&asi, "BD X=250000\r"), ":A\r\n"));
+  testMillis = 7000;
+  asi.checkHalt();
+  CHECK(same(send(&asi, "/\r"), "B\r\n"));//busy until the sketch says it isn't.
+  testMillis = 20000;
+  asi.checkHalt();
+  CHECK(Serial1.baud() == 250000);
+  Serial1.begin(0);
+  asi.begin();
+  CHECK(Serial1.baud() == 250000);
+  CHECK(same(send(&asi, "BAUD X=9600\r"), ":A\r\n"));
+  CHECK(same(send(&asi, "BAUD X?\r"), ":A X=9600\r\n"));
+}
+
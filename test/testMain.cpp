@@ -0,0 +1,50 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include <stdio.h>
+#include <string.h>
+#include "Check.h"
+
+//The tests are only worth anything if the sums overflow where they would on
+//the MEGA.
+static_assert(sizeof(long) == 4, "the tests must be built 32 bit, like the MEGA");
+
+static int checks = 0;
+static int failures = 0;
+
+void checkThat(int passed, const char *what, const char *file, int line)
+{
+  checks++;
+  if(!passed)
+  {
+    failures++;
+    printf("%s:%d: failed: %s\n", file, line, what);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if(argc > 1 && strcmp(argv[1], "trajectories") == 0)
+  {
+    dumpTrajectories();
+    return 0;
+  }
+  
+  testLines();
+  testProfiles();
+  testMoveTimes();
+  testSettleTimes();
+  testSegments();
+  testTiles();
+  testHaltLatency();
+  testCommandLine();
+  testCommands();
+  testCommandInput();
+  testBaud();
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures > 0;
+}
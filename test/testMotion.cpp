@@ -0,0 +1,336 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include <Arduino.h>
+#include "MotionProfile.h"
+#include "StepTimer.h"
+#include "Check.h"
+
+//ramp updates a second, as in the sketch.
+static const long rampTicksPerSec = F_CPU / RESOLUTION;
+
+//the default SPEED of 7.1 mm/s at the default CNTS of 1600 steps a mm.
+static const long topRate = 11360;
+
+//Run a line through and check every axis makes all its steps, and never
+//falls more than a step behind or ahead of where it should be.
+static void checkLine(long x, long y, long z)
+{
+  LineMove line;
+  planLine(&line, x, y, z);
+  CHECK(line.total == max(x, max(y, z)));
+  
+  LineAxis *axes[3] = {&line.x, &line.y, &line.z};
+  long steps[3] = {x, y, z};
+  long made[3] = {0, 0, 0};
+  int even = true;
+  for(long tick = 1; tick <= line.total; tick++)
+  {
+    for(int axis = AXIS_X; axis <= AXIS_Z; axis++)
+    {
+      if(isLineStepDue(axes[axis], line.total))
+      {
+        made[axis]++;
+      }
+      long long behind = (long long)steps[axis] * tick - (long long)made[axis] * line.total;
+      if(behind > line.total || behind < -line.total){even = false;}
+    }
+  }
+  CHECK(made[AXIS_X] == x);
+  CHECK(made[AXIS_Y] == y);
+  CHECK(made[AXIS_Z] == z);
+  CHECK(even);
+}
+
+void testLines()
+{
+  checkLine(1000, 0, 0);
+  checkLine(0, 1000, 0);
+  checkLine(0, 0, 1);
+  checkLine(1, 1, 1);
+  checkLine(7, 3, 5);
+  checkLine(3, 7, 2);
+  checkLine(1000, 999, 1);
+  checkLine(1000, 1, 999);
+  //further than the stage goes, the error terms must not overflow.
+  checkLine(2000000, 1999999, 3);
+}
+
+//An axis on its step timer. Times are in timer cycles.
+struct SimAxis {
+  unsigned long interval;//cycles between steps, 0 when stopped.
+  unsigned long wait;//cycles to the next step.
+};
+
+//What a new step rate does to the step times: a stopped axis steps straight away,
+//a running one keeps its next step unless the new interval is shorter.
+static void simStepRate(SimAxis *axis, long rate)
+{
+  if(rate <= 0)
+  {
+    axis->interval = 0;
+    return;
+  }
+  unsigned long interval = F_CPU / min(rate, MAX_STEP_RATE);
+  if(axis->interval == 0)
+  {
+    axis->wait = 0;
+  }
+  axis->interval = interval;
+  axis->wait = min(axis->wait, interval);
+}
+
+//Run the axis on for cycles, taking the steps due off the profile the way
+//the step interupt does. Returns the steps taken and puts the cycle of the
+//last one into lastStep.
+static long simSteps(SimAxis *axis, MotionProfile *profile, unsigned long cycles, unsigned long *lastStep)
+{
+  unsigned long left = cycles;
+  long steps = 0;
+  while(axis->interval != 0 && axis->wait < left)
+  {
+    left -= axis->wait;
+    *lastStep = cycles - left;
+    steps++;
+    if(--profile->stepsRemaining <= 0)
+    {
+      axis->interval = 0;
+      break;
+    }
+    axis->wait = axis->interval;
+  }
+  if(axis->interval != 0)
+  {
+    axis->wait -= left;
+  }
+  return steps;
+}
+
+//What running a profile did.
+struct ProfileRun {
+  float seconds;//until the last step.
+  long steps;
+  long peak;//top speed reached.
+  long first;//speed on the first ramp update.
+  long last;//speed on the ramp update of the last step.
+  int smooth;//no ramp update changed speed by more than the acceleration allows.
+};
+
+//Run a planned move a ramp update at a time, a profile tick and a new step
+//rate each update with the steps coming at that rate in between.
+static void runProfile(MotionProfile *planned, ProfileRun *run)
+{
+  MotionProfile profile = *planned;
+  SimAxis axis = {0, 0};
+  //an S-curve peaks at twice the average acceleration. Rounding the rate to
+  //whole steps a second adds a little.
+  long upChange = max(planned->upAccel, planned->upJerk * (planned->upTicks / 2));
+  long downChange = max(planned->downAccel, planned->downJerk * (planned->downTicks / 2));
+  long maxChange = (max(upChange, downChange) >> (ACCEL_SHIFT + RATE_SHIFT)) + 2;
+  long last = 0;
+  long ticks = 0;
+  run->seconds = 0;
+  run->steps = 0;
+  run->peak = 0;
+  run->smooth = true;
+  while(profile.stepsRemaining > 0 && ticks < 1000L * rampTicksPerSec)
+  {
+    long rate = profileTick(&profile);
+    simStepRate(&axis, rate);
+    unsigned long lastStep;
+    long steps = simSteps(&axis, &profile, RESOLUTION, &lastStep);
+    if(steps > 0)
+    {
+      run->steps += steps;
+      run->seconds = ((float)ticks * RESOLUTION + lastStep) / F_CPU;
+    }
+    if(ticks == 0){run->first = rate;}
+    ticks++;
+    run->peak = max(run->peak, rate);
+    run->last = rate;
+    if(ticks > 1 && labs(rate - last) > maxChange){run->smooth = false;}
+    last = rate;
+  }
+}
+
+//Seconds for a move of steps on a trapezoidal ramp.
+static float rampSeconds(long steps, long cruiseRate, long accelRate)
+{
+  float rampSteps = (float)cruiseRate * cruiseRate / accelRate;
+  if(rampSteps < steps)
+  {
+    return (float)steps / cruiseRate + (float)cruiseRate / accelRate;
+  }
+  return 2.0 * sqrt((float)steps / accelRate);
+}
+
+//Every move arrives on the exact step without going over speed or changing
+//speed faster than ACCEL allows, in about the time the ramp should take.
+static void checkProfile(long steps, long cruiseRate, long accelRate, int sCurve)
+{
+  MotionProfile profile;
+  ProfileRun run;
+  planProfile(&profile, steps, 0, cruiseRate, 0, accelRate, sCurve, rampTicksPerSec);
+  runProfile(&profile, &run);
+  CHECK(run.steps == steps);
+  CHECK(run.peak <= cruiseRate);
+  CHECK(run.smooth);
+  //starting and stopping at the minimum rate rather than still saves a
+  //little on short moves.
+  if(steps > 100 && accelRate > 0)
+  {
+    float seconds = rampSeconds(steps, cruiseRate, accelRate);
+    CHECK(fabs(run.seconds - seconds) <= seconds * 0.1 + 2.0 / rampTicksPerSec);
+  }
+}
+
+//A move that joins the ones either side starts at entryRate and is at
+//exitRate by its last step, as near as the acceleration allows.
+static void checkJoin(long steps, long entryRate, long cruiseRate, long exitRate, int sCurve)
+{
+  const long accelRate = cruiseRate * 1000L / 50;
+  MotionProfile profile;
+  ProfileRun run;
+  planProfile(&profile, steps, entryRate, cruiseRate, exitRate, accelRate, sCurve, rampTicksPerSec);
+  runProfile(&profile, &run);
+  long maxChange = accelRate / rampTicksPerSec * 2 + 2;
+  CHECK(run.steps == steps);
+  CHECK(run.peak <= cruiseRate);
+  CHECK(run.smooth);
+  CHECK(labs(run.first - entryRate) <= maxChange);
+  CHECK(run.last <= exitRate + maxChange);
+  if(steps > 1000)
+  {
+    CHECK(labs(run.last - exitRate) <= maxChange);
+  }
+}
+
+void testProfiles()
+{
+  for(int sCurve = false; sCurve <= true; sCurve++)
+  {
+    checkProfile(100000, MAX_STEP_RATE, 400000, sCurve);
+    checkProfile(100000, 11360, 22720, sCurve);
+    checkProfile(10000, 800, 1600, sCurve);
+    //too short to reach cruise speed.
+    checkProfile(5000, 11360, 22720, sCurve);
+    checkProfile(1, 11360, 22720, sCurve);
+    //no ramp at all.
+    checkProfile(30000, 11360, 0, sCurve);
+    
+    checkJoin(10000, 5000, 11360, 3000, sCurve);
+    checkJoin(10000, 11360, 11360, 11360, sCurve);
+    checkJoin(2000, 0, 11360, 8000, sCurve);
+    //too short to reach the exit speed, it gets as close as it can.
+    checkJoin(50, 0, 11360, 11360, sCurve);
+  }
+}
+
+//How long moves take on the ramps, against the same top speed started and
+//stopped dead.
+void testMoveTimes()
+{
+  long distances[] = {10, 100, 1000, 10000, 100000};
+  long accelTimes[] = {50, 500};
+  printf("move time against distance, %ld steps/s top speed\n", topRate);
+  printf("   steps   ACCEL=50ms  ACCEL=500ms  no ramp\n");
+  for(unsigned int i = 0; i < sizeof(distances) / sizeof(distances[0]); i++)
+  {
+    printf("%8ld", distances[i]);
+    for(unsigned int j = 0; j < sizeof(accelTimes) / sizeof(accelTimes[0]); j++)
+    {
+      MotionProfile profile;
+      ProfileRun run;
+      planProfile(&profile, distances[i], 0, topRate, 0, topRate * 1000L / accelTimes[j], false, rampTicksPerSec);
+      runProfile(&profile, &run);
+      CHECK(run.steps == distances[i]);
+      printf("   %8.3f s", run.seconds);
+    }
+    printf("   %8.3f s\n", (float)distances[i] / topRate);
+  }
+}
+
+//Run a move of steps into a stage with one resonance, a carriage on a spring
+//behind the motor with a little damping, and return the seconds until the
+//carriage stays within settleSteps of the target. accelRate of 0 starts and
+//stops dead. With a name the trajectory is printed as it goes.
+static float settleSeconds(long steps, long accelRate, int sCurve, float resonance, const char *name)
+{
+  const float damping = 0.03;
+  const float settleSteps = 0.5;
+  const int slices = 256;//integration steps per ramp update.
+  const unsigned long sliceCycles = RESOLUTION / slices;
+  float omega = 2 * M_PI * resonance;
+  float dt = (float)sliceCycles / F_CPU;
+  
+  MotionProfile planned;
+  planProfile(&planned, steps, 0, topRate, 0, accelRate, sCurve, rampTicksPerSec);
+  MotionProfile profile = planned;
+  SimAxis axis = {0, 0};
+  long motor = 0;
+  float carriage = 0;
+  float speed = 0;
+  long settledFrom = 0;
+  long slice = 0;
+  while(slice < 10L * rampTicksPerSec * slices && slice - settledFrom < rampTicksPerSec * slices)
+  {
+    if(profile.stepsRemaining > 0)
+    {
+      simStepRate(&axis, profileTick(&profile));
+    }
+    for(int i = 0; i < slices; i++, slice++)
+    {
+      unsigned long lastStep;
+      if(profile.stepsRemaining > 0)
+      {
+        motor += simSteps(&axis, &profile, sliceCycles, &lastStep);
+      }
+      speed += (omega * omega * (motor - carriage) - 2 * damping * omega * speed) * dt;
+      carriage += speed * dt;
+      if(profile.stepsRemaining > 0 || fabs(carriage - steps) > settleSteps)
+      {
+        settledFrom = slice + 1;
+      }
+      if(name != NULL && i % 16 == 0)
+      {
+        printf("%s,%.5f,%ld,%.3f\n", name, slice * dt, motor, carriage);
+      }
+    }
+  }
+  return settledFrom * dt;
+}
+
+//Move plus settle time of 1000 steps at a few stage resonances, started and
+//stopped dead and on the ramps with the default 50 ms ACCEL.
+void testSettleTimes()
+{
+  const long steps = 1000;
+  const long accelRate = topRate * 1000L / 50;
+  float resonances[] = {27, 55, 90};
+  printf("move and settle to half a step, %ld steps at %ld steps/s, 0.03 damping\n", steps, topRate);
+  printf("  resonance    no ramp  trapezoid 50ms  S-curve 50ms\n");
+  for(unsigned int i = 0; i < sizeof(resonances) / sizeof(resonances[0]); i++)
+  {
+    float constant = settleSeconds(steps, 0, false, resonances[i], NULL);
+    float trapezoid = settleSeconds(steps, accelRate, false, resonances[i], NULL);
+    float sCurve = settleSeconds(steps, accelRate, true, resonances[i], NULL);
+    CHECK(trapezoid < constant);
+    CHECK(sCurve < constant);
+    printf("   %5.0f Hz   %6.3f s     %6.3f s      %6.3f s\n", resonances[i], constant, trapezoid, sCurve);
+  }
+}
+
+//The trajectories behind testSettleTimes at 55 Hz, as comma separated
+//profile, seconds, motor and carriage position in steps.
+void dumpTrajectories()
+{
+  const long accelRate = topRate * 1000L / 50;
+  printf("profile,seconds,motor,carriage\n");
+  settleSeconds(1000, 0, false, 55, "constant");
+  settleSeconds(1000, accelRate, false, 55, "trapezoid");
+  settleSeconds(1000, accelRate, true, 55, "scurve");
+}
@@ -0,0 +1,350 @@
+/* Microscope controller for Arduino
+ * By Dustin Andrews, Frank Luecke, David Luecke and Allen Burnham, 2012
+ * This work is licensed under a Creative Commons Attribution 3.0 Unported License.
+ * http://creativecommons.org/licenses/by/3.0/
+ * This program is design to run on Arduino MEGA
+ * Code available from https://github.com/dustinandrews/microscope
+ */
+#include <Arduino.h>
+#include "MoveQueue.h"
+#include "SegmentBuffer.h"
+#include "StepTimer.h"
+#include "Check.h"
+
+//ramp updates a second, as in the sketch.
+static const long ticksPerSec = F_CPU / RESOLUTION;
+
+//What came out of the segment buffer for one line.
+struct LineSegments {
+  LineMove line;
+  long steps;//lead axis steps over all its segments.
+  uint8_t directions;
+  int triggers;
+  int same;//every segment had the line's directions.
+  unsigned long firstInterval;
+  unsigned long lastInterval;
+  float seconds;//time the lead axis takes over its segments.
+};
+
+//Take segments the way the step interupt does, starting a new entry in lines
+//at each new line, until there are none left or count segments are taken.
+//Returns the number of lines.
+static int takeSegments(LineSegments *lines, int maxLines, long count)
+{
+  MoveSegment segment;
+  LineMove line;
+  int found = 0;
+  int fast = true;
+  for(long taken = 0; taken < count; taken++)
+  {
+    prepareSegments(ticksPerSec);
+    if(!takeSegment(&segment, &line))
+    {
+      break;
+    }
+    if(segment.interval < F_CPU / MAX_STEP_RATE){fast = false;}
+    if(segment.newLine || found == 0)
+    {
+      if(found == maxLines)
+      {
+        break;
+      }
+      LineSegments *next = &lines[found++];
+      next->line = line;
+      next->steps = 0;
+      next->directions = segment.directions;
+      next->triggers = 0;
+      next->same = true;
+      next->firstInterval = segment.interval;
+      next->seconds = 0;
+    }
+    LineSegments *current = &lines[found - 1];
+    current->steps += segment.steps;
+    current->triggers += segment.trigger;
+    current->lastInterval = segment.interval;
+    current->seconds += (float)segment.steps * segment.interval / F_CPU;
+    if(segment.directions != current->directions)
+    {
+      current->same = false;
+    }
+  }
+  CHECK(fast);
+  return found;
+}
+
+//Throw away anything left over from the test before.
+static void resetSegments()
+{
+  LineSegments lines[1];
+  while(takeSegments(lines, 1, 1000000) > 0);
+  CHECK(!moveSegmentsPending());
+}
+
+//Each move comes out as its own line, with all its steps, its directions on
+//every segment and the TTL pulse on just its first if it asked for one.
+static void testMoves()
+{
+  resetSegments();
+  AxisSettings first = {3000, -1000, 500};
+  AxisSettings second = {-200, 0, 4000};
+  queueMove(&first, 4000, 200, false, true, ticksPerSec);
+  queueMove(&second, 4000, 20, true, false, ticksPerSec);
+  
+  LineSegments lines[3];
+  int found = takeSegments(lines, 3, 1000000);
+  CHECK(found == 2);
+  CHECK(!moveSegmentsPending());
+  
+  CHECK(lines[0].line.total == 3000);
+  CHECK(lines[0].line.x.steps == 3000);
+  CHECK(lines[0].line.y.steps == 1000);
+  CHECK(lines[0].line.z.steps == 500);
+  CHECK(lines[0].steps == 3000);
+  CHECK(lines[0].directions == (SEGMENT_DIR(AXIS_X) | SEGMENT_DIR(AXIS_Z)));
+  CHECK(lines[0].triggers == 1);
+  CHECK(lines[0].same);
+  
+  CHECK(lines[1].line.total == 4000);
+  CHECK(lines[1].steps == 4000);
+  CHECK(lines[1].directions == SEGMENT_DIR(AXIS_Z));
+  CHECK(lines[1].triggers == 0);
+  CHECK(lines[1].same);
+}
+
+//Two moves in a straight line run through the join at full speed, and the
+//second still stops at its end.
+static void testJoin()
+{
+  resetSegments();
+  AxisSettings steps = {5000, 2000, 0};
+  queueMove(&steps, 4000, 200, false, false, ticksPerSec);
+  queueMove(&steps, 4000, 200, false, false, ticksPerSec);
+  
+  LineSegments lines[2];
+  CHECK(takeSegments(lines, 2, 1000000) == 2);
+  CHECK(lines[0].steps == 5000);
+  CHECK(lines[1].steps == 5000);
+  //the line speed is shared out, the lead axis makes 5000 of its 5385 steps.
+  long leadRate = 4000L * 5000 / 5385;
+  CHECK(labs((long)(F_CPU / lines[0].lastInterval) - leadRate) < leadRate / 20);
+  CHECK(labs((long)(F_CPU / lines[1].firstInterval) - leadRate) < leadRate / 20);
+  CHECK(F_CPU / lines[0].firstInterval < 1000);
+  CHECK(F_CPU / lines[1].lastInterval < 1000);
+}
+
+//Only axes finishing in the negative direction with a BACKLASH set run past
+//and come back, by BACKLASH plus any positive OVERSHOOT.
+static void testApproach()
+{
+  CHECK(approachSteps(1000, 0.05, 0.01, 1600) == 0);
+  CHECK(approachSteps(0, 0.05, 0.01, 1600) == 0);
+  CHECK(approachSteps(-1000, 0, 0.01, 1600) == 0);
+  CHECK(approachSteps(-1000, 0.05, 0.01, 1600) == 96);
+  CHECK(approachSteps(-1, 0.05, -0.01, 1600) == 80);
+  //each axis has its own CNTS.
+  CHECK(approachSteps(-1000, 0.05, 0.01, 25400) == 1524);
+}
+
+//Seconds to run lines queued together, as one command queues them.
+static float runLines(AxisSettings *lines, int count)
+{
+  resetSegments();
+  for(int i = 0; i < count; i++)
+  {
+    queueMove(&lines[i], 11360, 50, false, false, ticksPerSec);
+  }
+  LineSegments taken[2];
+  int found = takeSegments(taken, 2, 1000000);
+  CHECK(found == count);
+  float seconds = 0;
+  for(int i = 0; i < found; i++)
+  {
+    seconds += taken[i].seconds;
+  }
+  return seconds;
+}
+
+//How a host running a tile scan gets on, sending a MOVE per command and
+//polling STATUS every 10 ms until the stage is no longer busy, all at 9600
+//baud. Counts the commands and adds up the time.
+struct HostRun {
+  int moves;
+  int commands;
+  float seconds;
+};
+
+static void hostCommand(HostRun *run, int bytes)
+{
+  const float byteSeconds = 10.0 / 9600;
+  run->commands++;
+  run->seconds += bytes * byteSeconds;
+}
+
+static void hostMove(HostRun *run, AxisSettings *lines, int count)
+{
+  const float pollSeconds = 0.010;
+  run->moves++;
+  hostCommand(run, 24);//"M X=123456 Y=123456\r" and ":A\r\n".
+  float done = run->seconds + runLines(lines, count);
+  do
+  {
+    run->seconds += pollSeconds;
+    hostCommand(run, 5);//"/\r" and "N\r\n".
+  } while(run->seconds < done);
+}
+
+//A 5x5 tile scan that goes back and forth along the rows, 2000 steps a tile
+//with 1000 steps of backlash, so every other row finishes each move in the
+//negative direction. Either the host runs past and comes back with a second
+//MOVE, or BACKLASH is set and the firmware queues both lines from one.
+void testTiles()
+{
+  const long tile = 2000;
+  const long backlash = 1000;
+  HostRun host = {0, 0, 0};
+  HostRun firmware = {0, 0, 0};
+  AxisSettings at = {0, 0, 0};
+  for(int row = 0; row < 5; row++)
+  {
+    for(int column = 0; column < 5; column++)
+    {
+      AxisSettings to = {tile * (row % 2 == 0 ? column : 4 - column), tile * row, 0};
+      AxisSettings steps = {to.x - at.x, to.y - at.y, 0};
+      at = to;
+      if(steps.x == 0 && steps.y == 0)
+      {
+        continue;
+      }
+      AxisSettings approach = {approachSteps(steps.x, backlash / 1600.0, 0, 1600), 0, 0};
+      if(approach.x == 0)
+      {
+        hostMove(&host, &steps, 1);
+        hostMove(&firmware, &steps, 1);
+        continue;
+      }
+      AxisSettings lines[2] = {{steps.x - approach.x, steps.y, 0}, approach};
+      hostMove(&host, &lines[0], 1);
+      hostMove(&host, &lines[1], 1);
+      hostMove(&firmware, lines, 2);
+    }
+  }
+  CHECK(firmware.moves < host.moves);
+  CHECK(firmware.commands < host.commands);
+  CHECK(firmware.seconds < host.seconds);
+  printf("5x5 tile scan with backlash, %ld step tiles, 9600 baud, STATUS every 10 ms\n", tile);
+  printf("  host does the approach      %d MOVEs, %d commands, %.2f s\n", host.moves, host.commands, host.seconds);
+  printf("  firmware does the approach  %d MOVEs, %d commands, %.2f s\n", firmware.moves, firmware.commands, firmware.seconds);
+}
+
+//Run a move of steps at speed from the segment buffer the way the step and
+//ramp interupts do, with a \ arriving byteTime seconds after the first step.
+//The ramp interupt sees the \ on its next tick and ramps the lead axis down
+//from the speed of its segment, so loop() has no part in how soon the stage
+//stops. Returns the seconds from the byte to the last step, or -1 if the move
+//was over before the HALT was seen.
+static float haltLatency(long steps, float speed, long accelTime, float byteTime)
+{
+  resetSegments();
+  AxisSettings move = {steps, steps / 3, 0};
+  queueMove(&move, speed, accelTime, false, false, ticksPerSec);
+  prepareSegments(ticksPerSec);
+  MoveSegment segment;
+  LineMove line;
+  CHECK(takeSegment(&segment, &line));
+  
+  //times are in timer cycles. wakeStepTimer puts the first ramp tick
+  //STEP_LEAD after the first step.
+  unsigned long long byteAt = (unsigned long long)(byteTime * F_CPU);
+  unsigned long long nextStep = 0;
+  unsigned long long lastStep = 0;
+  unsigned long long nextTick = STEP_LEAD;
+  unsigned long interval = segment.interval;
+  long left = segment.steps;
+  int halting = false;
+  StopRamp ramp;
+  for(;;)
+  {
+    if(nextStep < nextTick)
+    {
+      lastStep = nextStep;
+      if(--left <= 0 && !halting)
+      {
+        //the foreground keeps the buffer topped up.
+        prepareSegments(ticksPerSec);
+        if(!takeSegment(&segment, &line))
+        {
+          return -1;
+        }
+        left = segment.steps;
+        interval = segment.interval;
+      }
+      nextStep += interval;
+      continue;
+    }
+    
+    if(!halting && nextTick >= byteAt)
+    {
+      halting = true;
+      planStopRamp(&ramp, F_CPU / interval, segment.accel, ticksPerSec);
+    }
+    if(halting)
+    {
+      long rate = stopRampTick(&ramp);
+      if(rate == 0)
+      {
+        return lastStep > byteAt ? (float)(lastStep - byteAt) / F_CPU : 0;
+      }
+      interval = F_CPU / min(rate, MAX_STEP_RATE);
+    }
+    nextTick += RESOLUTION;
+  }
+}
+
+//The worst time from a \ arriving to the last step, over HALTs every 1.3 ms
+//through a move: on the ramp up, at speed and on the ramp down. It is never
+//more than a tick to see the \ and a tick of rounding longer than the ramp
+//down itself takes.
+static void checkHaltLatency(float speed, long accelTime)
+{
+  const long steps = 30000;
+  float worst = 0;
+  float worstAt = 0;
+  int halts = 0;
+  for(float byteTime = 0; ; byteTime += 0.0013)
+  {
+    float latency = haltLatency(steps, speed, accelTime, byteTime);
+    if(latency < 0)
+    {
+      break;
+    }
+    halts++;
+    if(latency > worst)
+    {
+      worst = latency;
+      worstAt = byteTime;
+    }
+  }
+  float lead = speed * steps / sqrt((float)steps * steps + (steps / 3) * (steps / 3));
+  float ramp = min(lead, (float)MAX_STEP_RATE) / lead * accelTime / 1000.0;
+  CHECK(halts > 100);
+  CHECK(worst <= ramp + 2.0 / ticksPerSec);
+  printf("  %5.0f steps/s  ACCEL=%3ldms  %4d HALTs  worst %6.1f ms at %5.3f s, ramp %5.1f ms\n",
+    speed, accelTime, halts, worst * 1000, worstAt, ramp * 1000);
+}
+
+//How soon the stage stops after a \ arrives.
+void testHaltLatency()
+{
+  printf("HALT byte to last step, %ld step move\n", 30000L);
+  checkHaltLatency(11360, 50);
+  checkHaltLatency(20000, 100);
+  checkHaltLatency(11360, 500);
+  checkHaltLatency(4000, 0);
+}
+
+void testSegments()
+{
+  testMoves();
+  testJoin();
+  testApproach();
+}